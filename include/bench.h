@@ -0,0 +1,13 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/include/bench.h
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#ifndef __LOLI_BENCH_H_INC__
+#define __LOLI_BENCH_H_INC__
+
+int bench_file(const char *path);
+
+#endif	// __LOLI_BENCH_H_INC__
@@ -9,5 +9,8 @@
 #define __LOLI_CTYPE_H_INC__
 
 int isprint(int c);
+int isdigit(int c);
+int tolower(int c);
+int toupper(int c);
 
 #endif	// __LOLI_CTYPE_H_INC__
@@ -48,5 +48,6 @@ extern Efi_Boot_Services *gBS;
 extern Efi_Handle gSelf;
 
 void efi_init(Efi_Handle imageHandle, Efi_System_Table *st);
+void *efi_get_configuration_table(Efi_Guid guid);
 
 #endif	// __LOLI_EFI_H_INC__
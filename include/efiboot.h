@@ -43,6 +43,18 @@ typedef enum {
 	EFI_MAX_MEMORY_TYPE
 } Efi_Memory_Type;
 
+/*
+ * Firmware may report descriptors larger than this, walk the map with the
+ * descriptor size returned by getMemoryMap().
+ */
+typedef struct {
+	uint32_t type;
+	uint64_t physicalStart;
+	uint64_t virtualStart;
+	uint64_t numberOfPages;
+	uint64_t attribute;
+} Efi_Memory_Descriptor;
+
 #define EVT_TIMER			0x80000000
 #define EVT_NOTIFY_WAIT			0x00000100
 
@@ -73,7 +85,11 @@ typedef struct {
 				    uint_native pages,
 				    void **memory);
 	Efi_Status (*freePages)(void *memory, uint_native pages);
-	Efi_Handle getMemoryMap;
+	Efi_Status (*getMemoryMap)(uint_native *memoryMapSize,
+				   Efi_Memory_Descriptor *memoryMap,
+				   uint_native *mapKey,
+				   uint_native *descriptorSize,
+				   uint32_t *descriptorVersion);
 
 	Efi_Status (*allocatePool)(Efi_Memory_Type type, uint_native size,
 				   void **buf);
@@ -120,7 +136,7 @@ typedef struct {
 	Efi_Handle exitBootServices;
 
 	Efi_Handle getNextMonotonicCount;
-	Efi_Handle stall;
+	Efi_Status (*stall)(uint_native microseconds);
 	Efi_Handle setWatchdogTimer;
 
 	Efi_Handle connectController;
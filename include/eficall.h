@@ -11,6 +11,7 @@
 #if defined(LOLI_TARGET_RISCV64) || defined(LOLI_TARGET_LOONGARCH64) || \
     defined(LOLI_TARGET_AARCH64)
 #define efi_call(f, ...) ((f)(__VA_ARGS__))
+#define efi_callback(name) name
 #elif defined(LOLI_TARGET_X86_64)
 
 unsigned long __efi_call1(unsigned long int, ...);
@@ -48,6 +49,12 @@ unsigned long __efi_call10(unsigned long int, ...);
 #define efi_call(f, ...) \
 	efi_call_concat(_efi_call,efi_call_nargs(__VA_ARGS__))(f, __VA_ARGS__)
 
+/*
+ * Functions called by the firmware are wrapped by WIN32_ENTRY() in eficall.S,
+ * which calls the SystemV implementation prefixed with an underscore.
+ */
+#define efi_callback(name) _##name
+
 #else
 #error "Unknown target"
 #endif
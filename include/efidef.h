@@ -56,8 +56,12 @@ typedef struct {
 
 #define EFI_SUCCESS			0
 #define EFI_INVALID_PARAMETER		2
+#define EFI_UNSUPPORTED			3
 #define EFI_BUFFER_TOO_SMALL		5
+#define EFI_DEVICE_ERROR		7
+#define EFI_WRITE_PROTECTED		8
 #define EFI_OUT_OF_RESOURCES		9
+#define EFI_VOLUME_CORRUPTED		10
 #define EFI_NOT_FOUND			14
 
 #endif	// __LOLI_EFIDEF_H_INC__
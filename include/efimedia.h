@@ -12,6 +12,9 @@
 
 #define EFI_FILE_MODE_READ		0x0000000000000001
 
+#define EFI_FILE_PROTOCOL_REVISION	0x00010000
+#define EFI_FILE_PROTOCOL_REVISION2	0x00020000
+
 #define EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_GUID \
 	EFI_GUID(0x0964e5b22, 0x6459, 0x11d2,				\
 		 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b)
@@ -19,6 +22,14 @@
 	EFI_GUID(0x09576e92, 0x6d3f, 0x11d2,				\
 		 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b)
 
+#define EFI_BLOCK_IO_PROTOCOL_GUID \
+	EFI_GUID(0x964e5b21, 0x6459, 0x11d2,				\
+		 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b)
+
+#define EFI_DISK_IO_PROTOCOL_GUID \
+	EFI_GUID(0xce345171, 0xba0b, 0x11d2,				\
+		 0x8e, 0x4f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b)
+
 #define EFI_LOAD_FILE_PROTOCOL_GUID \
 	EFI_GUID(0x56ec3091, 0x954c, 0x11d2,				\
 		 0x8e, 0x3f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b)
@@ -56,10 +67,22 @@ typedef struct {
 	wchar_t fileName[];
 } Efi_File_Info;
 
-#define EFI_FILE_DIRECTORY 0x10
+#define EFI_FILE_READ_ONLY	0x01
+#define EFI_FILE_HIDDEN		0x02
+#define EFI_FILE_SYSTEM		0x04
+#define EFI_FILE_DIRECTORY	0x10
+#define EFI_FILE_ARCHIVE	0x20
+#define EFI_FILE_VALID_ATTR	0x37
 
 struct Efi_File_Protocol;
 
+typedef struct {
+	Efi_Event event;
+	Efi_Status status;
+	uint_native bufferSize;
+	void *buffer;
+} Efi_File_Io_Token;
+
 typedef struct Efi_Simple_File_System_Protocol {
 	uint64_t revision;
 	Efi_Status (*openVolume)(struct Efi_Simple_File_System_Protocol *this,
@@ -77,14 +100,59 @@ typedef struct Efi_File_Protocol {
 	Efi_Status (*read)(struct Efi_File_Protocol *this, uint_native *bufSize,
 			   void *buf);
 	Efi_Handle write;
-	Efi_Handle getPosition;
-	Efi_Handle setPosition;
+	Efi_Status (*getPosition)(struct Efi_File_Protocol *this,
+				  uint64_t *position);
+	Efi_Status (*setPosition)(struct Efi_File_Protocol *this,
+				  uint64_t position);
 	Efi_Status (*getInfo)(struct Efi_File_Protocol *this,
 			      Efi_Guid *informationType,
 			      uint_native *bufSize, void *buf);
 	Efi_Handle setInfo;
+	Efi_Handle flush;
+
+	/* Revision 2 */
+	Efi_Status (*openEx)(struct Efi_File_Protocol *this,
+			     struct Efi_File_Protocol **newHandle,
+			     wchar_t *filename, uint64_t openMode,
+			     uint64_t attributes, Efi_File_Io_Token *token);
+	Efi_Status (*readEx)(struct Efi_File_Protocol *this,
+			     Efi_File_Io_Token *token);
+	Efi_Handle writeEx;
+	Efi_Status (*flushEx)(struct Efi_File_Protocol *this,
+			      Efi_File_Io_Token *token);
 } Efi_File_Protocol;
 
+typedef struct {
+	uint32_t mediaId;
+	bool removableMedia;
+	bool mediaPresent;
+	bool logicalPartition;
+	bool readOnly;
+	bool writeCaching;
+	uint32_t blockSize;
+	uint32_t ioAlign;
+	uint64_t lastBlock;
+} Efi_Block_Io_Media;
+
+typedef struct Efi_Block_Io_Protocol {
+	uint64_t revision;
+	Efi_Block_Io_Media *media;
+	Efi_Handle reset;
+	Efi_Status (*readBlocks)(struct Efi_Block_Io_Protocol *this,
+				 uint32_t mediaId, uint64_t lba,
+				 uint_native bufSize, void *buf);
+	Efi_Handle writeBlocks;
+	Efi_Handle flushBlocks;
+} Efi_Block_Io_Protocol;
+
+typedef struct Efi_Disk_Io_Protocol {
+	uint64_t revision;
+	Efi_Status (*readDisk)(struct Efi_Disk_Io_Protocol *this,
+			       uint32_t mediaId, uint64_t offset,
+			       uint_native bufSize, void *buf);
+	Efi_Handle writeDisk;
+} Efi_Disk_Io_Protocol;
+
 typedef struct Efi_Load_File_Protocol {
 	Efi_Status (*loadFile)(struct Efi_Load_File_Protocol *p,
 			       Efi_Device_Path_Protocol *dp,
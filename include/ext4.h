@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/include/ext4.h
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#ifndef __LOLI_EXT4_H_INC__
+#define __LOLI_EXT4_H_INC__
+
+#include <efidef.h>
+#include <efimedia.h>
+
+int ext4_open_volumes(Efi_File_Protocol **roots, int max);
+void ext4_report(void);
+
+#endif	// __LOLI_EXT4_H_INC__
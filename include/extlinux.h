@@ -7,8 +7,47 @@
 #ifndef __LOLI_EXTLINUX_H_INC__
 #define __LOLI_EXTLINUX_H_INC__
 
+#include "extlinuxkeys.h"
+
+/* A value in the configuration, NULL if the key is absent */
+typedef struct {
+	const char *value;
+	unsigned long int len;
+} Extlinux_Value;
+
+typedef struct {
+	Extlinux_Key key;
+	Extlinux_Value value;
+} Extlinux_Pair;
+
+typedef struct {
+	Extlinux_Value values[EXTLINUX_KEY_NUM];
+} Extlinux_Entry;
+
+typedef struct {
+	Extlinux_Entry global;
+	Extlinux_Entry *entries;
+	unsigned long int entryMax;
+	unsigned long int entryNum;
+} Extlinux_Index;
+
 const char *extlinux_next_entry(const char *conf, const char *last);
 const char *extlinux_get_value(const char *conf, const char *key,
 			       unsigned long int *valuelen);
 
+const char *extlinux_key_name(Extlinux_Key key);
+unsigned long int extlinux_parse(const char *conf, Extlinux_Pair *pairs,
+				 unsigned long int pairMax);
+void extlinux_index_init(Extlinux_Index *index, Extlinux_Entry *entries,
+			 unsigned long int entryMax);
+void extlinux_index_add(Extlinux_Index *index, const char *conf);
+void extlinux_index_add_pairs(Extlinux_Index *index,
+			      const Extlinux_Pair *pairs,
+			      unsigned long int num);
+Extlinux_Entry *extlinux_index_add_entry(Extlinux_Index *index,
+					 const char *conf,
+					 const Extlinux_Value *label);
+int extlinux_version_compare(const Extlinux_Value *a,
+			     const Extlinux_Value *b);
+
 #endif	// __LOLI_EXTLINUX_H_INC__
@@ -0,0 +1,87 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/include/extlinuxkeys.h
+ *	Generated by tools/extlinuxkeys.py, DO NOT EDIT.
+ */
+
+#ifndef __LOLI_EXTLINUXKEYS_H_INC__
+#define __LOLI_EXTLINUXKEYS_H_INC__
+
+typedef enum {
+	EXTLINUX_KEY_LABEL,
+	EXTLINUX_KEY_MENU_TITLE,
+	EXTLINUX_KEY_KERNEL,
+	EXTLINUX_KEY_FDT,
+	EXTLINUX_KEY_DEVICETREE,
+	EXTLINUX_KEY_INITRD,
+	EXTLINUX_KEY_APPEND,
+	EXTLINUX_KEY_BENCHFILE,
+	EXTLINUX_KEY_DEFAULT,
+	EXTLINUX_KEY_TIMEOUT,
+	EXTLINUX_KEY_MEMMAP,
+	EXTLINUX_KEY_INCLUDE,
+	EXTLINUX_KEY_TITLE,
+	EXTLINUX_KEY_VERSION,
+	EXTLINUX_KEY_LINUX,
+	EXTLINUX_KEY_OPTIONS,
+	EXTLINUX_KEY_SORT_KEY,
+	EXTLINUX_KEY_NUM,
+} Extlinux_Key;
+
+#ifdef EXTLINUX_KEYS_TABLE
+
+#define EXTLINUX_KEY_HASH_SIZE	64
+#define EXTLINUX_KEY_HASH(first, last, len) \
+	(((first) * 3 + (last) * 5 + (len)) % EXTLINUX_KEY_HASH_SIZE)
+
+static const char *keyNames[EXTLINUX_KEY_NUM] = {
+	[EXTLINUX_KEY_LABEL]		= "label",
+	[EXTLINUX_KEY_MENU_TITLE]	= "menu title",
+	[EXTLINUX_KEY_KERNEL]		= "kernel",
+	[EXTLINUX_KEY_FDT]		= "fdt",
+	[EXTLINUX_KEY_DEVICETREE]	= "devicetree",
+	[EXTLINUX_KEY_INITRD]		= "initrd",
+	[EXTLINUX_KEY_APPEND]		= "append",
+	[EXTLINUX_KEY_BENCHFILE]	= "benchfile",
+	[EXTLINUX_KEY_DEFAULT]		= "default",
+	[EXTLINUX_KEY_TIMEOUT]		= "timeout",
+	[EXTLINUX_KEY_MEMMAP]		= "memmap",
+	[EXTLINUX_KEY_INCLUDE]		= "include",
+	[EXTLINUX_KEY_TITLE]		= "title",
+	[EXTLINUX_KEY_VERSION]		= "version",
+	[EXTLINUX_KEY_LINUX]		= "linux",
+	[EXTLINUX_KEY_OPTIONS]		= "options",
+	[EXTLINUX_KEY_SORT_KEY]		= "sort-key",
+};
+
+/*
+ * Keys by hash of their first token, num is zero for empty slots. Keys sharing
+ * a first token start from key and are consecutive.
+ */
+static const struct {
+	unsigned char key;
+	unsigned char num;
+} keyHash[EXTLINUX_KEY_HASH_SIZE] = {
+	[15]	= { EXTLINUX_KEY_VERSION, 1 },
+	[19]	= { EXTLINUX_KEY_OPTIONS, 1 },
+	[20]	= { EXTLINUX_KEY_MENU_TITLE, 1 },
+	[26]	= { EXTLINUX_KEY_TITLE, 1 },
+	[29]	= { EXTLINUX_KEY_APPEND, 1 },
+	[33]	= { EXTLINUX_KEY_LINUX, 1 },
+	[35]	= { EXTLINUX_KEY_KERNEL, 1 },
+	[37]	= { EXTLINUX_KEY_LABEL, 1 },
+	[39]	= { EXTLINUX_KEY_TIMEOUT, 1 },
+	[40]	= { EXTLINUX_KEY_BENCHFILE, 1 },
+	[47]	= { EXTLINUX_KEY_DEVICETREE, 1 },
+	[53]	= { EXTLINUX_KEY_INITRD, 1 },
+	[55]	= { EXTLINUX_KEY_DEFAULT, 1 },
+	[57]	= { EXTLINUX_KEY_FDT, 1 },
+	[59]	= { EXTLINUX_KEY_INCLUDE, 1 },
+	[61]	= { EXTLINUX_KEY_MEMMAP, 1 },
+	[62]	= { EXTLINUX_KEY_SORT_KEY, 1 },
+};
+
+#endif	// EXTLINUX_KEYS_TABLE
+
+#endif	// __LOLI_EXTLINUXKEYS_H_INC__
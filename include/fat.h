@@ -0,0 +1,16 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/include/fat.h
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#ifndef __LOLI_FAT_H_INC__
+#define __LOLI_FAT_H_INC__
+
+#include <efidef.h>
+#include <efimedia.h>
+
+int fat_open_volume(Efi_Handle device, Efi_File_Protocol **root);
+
+#endif	// __LOLI_FAT_H_INC__
@@ -10,6 +10,10 @@
 
 #include <efidef.h>
 
+#define FDT_MAGIC		0xd00dfeed
+/* Version 17 is the latest, which is compatible with version 16 */
+#define FDT_LAST_COMP_VERSION	16
+
 #pragma pack(push, 0)
 
 typedef struct {
@@ -24,6 +28,7 @@ typedef struct {
 
 #pragma pack(pop)
 
-void fdt_fixup_and_load(Fdt_Header *fdt);
+int fdt_check_header(const Fdt_Header *fdt, uint64_t fileSize);
+Fdt_Header *fdt_fixup_and_load(Fdt_Header *fdt);
 
 #endif	// __LOLI_FDT_H_INC__
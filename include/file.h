@@ -10,14 +10,117 @@
 
 #include <efidef.h>
 #include <efimedia.h>
+#include <placement.h>
+
+typedef enum {
+	FILE_ALLOC_POOL,
+	FILE_ALLOC_PAGES,
+} File_Alloc_Type;
+
+/*
+ * I/O statistics of every path looked up, installed as a configuration table
+ * with LOLI_FILE_STATS_TABLE_GUID when loli exits. Times are in ticks of
+ * timerFrequency.
+ */
+#define LOLI_FILE_STATS_TABLE_GUID \
+	EFI_GUID(0x99f52590, 0x3d87, 0x4d2e,				\
+		 0xae, 0x85, 0x18, 0x31, 0x99, 0x69, 0x70, 0xad)
+
+#define FILE_STATS_VERSION	1
+#define FILE_STATS_PATH_MAX	128
+
+typedef struct {
+	char path[FILE_STATS_PATH_MAX];
+	uint64_t opens;
+	uint64_t getInfos;
+	uint64_t reads;
+	uint64_t cacheHits;
+	uint64_t bytes;
+	uint64_t lookupTicks;
+	uint64_t readTicks;
+} File_Stats;
+
+typedef struct {
+	uint32_t version;
+	uint32_t fileNum;
+	uint64_t timerFrequency;
+	File_Stats files[];
+} File_Stats_Table;
+
+typedef struct {
+	Efi_File_Protocol *file;
+	uint64_t size;
+	uint64_t offset;
+	size_t chunkSize;
+	File_Stats *stats;
+} File_Stream;
+
+/*
+ * Called for every chunk read by file_stream_consume(), offset is the position
+ * of the chunk in the file. Return non-zero to abort the stream.
+ */
+typedef int (*File_Chunk_Consumer)(void *ctx, const void *chunk, size_t size,
+				   uint64_t offset);
+
+typedef struct {
+	const char *path;
+	File_Alloc_Type type;
+	size_t extra;
+	/* Alignment and placement of FILE_ALLOC_PAGES buffers */
+	size_t align;
+	Placement_Hint placement;
+
+	void *buf;
+	int64_t size;
+
+	/* Private to file_load_batch() */
+	File_Stream stream;
+	Efi_File_Io_Token token;
+	int pending;
+} File_Load_Request;
+
+typedef struct {
+	const char *name;
+	uint64_t size;
+	int isDir;
+} File_Dir_Entry;
+
+/* A sorted listing of a directory, see file_dir_open() */
+typedef struct File_Dir {
+	File_Dir_Entry *entries;
+	size_t num;
+
+	/* Private to file.c */
+	wchar_t *path;
+	char *names;
+	struct File_Dir *next;
+} File_Dir;
 
 void file_init(void);
+void file_fini(void);
+void file_stats_report(void);
 
 Efi_File_Protocol *file_open(const wchar_t *path);
 void file_close(Efi_File_Protocol *file);
 Efi_Status file_get_info(Efi_File_Protocol *file, Efi_File_Info **info);
 
 int64_t file_get_size(const char *path);
-int64_t file_load(const char *path, void **buf);
+int64_t file_read_partial(const char *path, uint64_t offset, void *buf,
+			  size_t size);
+int file_stream_open(File_Stream *s, const char *path, size_t chunkSize);
+int64_t file_stream_read(File_Stream *s, void *buf, size_t bufSize);
+int file_stream_seek(File_Stream *s, uint64_t offset);
+int64_t file_stream_consume(File_Stream *s, void *buf, size_t bufSize,
+			    File_Chunk_Consumer consumer, void *ctx);
+void file_stream_close(File_Stream *s);
+
+int64_t file_load_alloc(const char *path, File_Alloc_Type type, size_t extra,
+			void **buf);
+void file_load_batch(File_Load_Request *reqs, size_t num);
+void file_load_release(File_Load_Request *req);
+
+const File_Dir *file_dir_open(const char *path);
+const File_Dir_Entry *file_dir_match(const File_Dir *dir, const char *pattern,
+				     const File_Dir_Entry *last);
 
 #endif	// __LOLI_FILE_H_INC__
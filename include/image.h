@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/include/image.h
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#ifndef __LOLI_IMAGE_H_INC__
+#define __LOLI_IMAGE_H_INC__
+
+#include <efidef.h>
+
+/* Enough to cover DOS, PE and section headers of a usual kernel */
+#define IMAGE_HEADER_SIZE	4096
+
+int image_check_header(const void *header, size_t size, uint64_t fileSize);
+uint32_t image_get_alignment(const void *header);
+
+#endif	// __LOLI_IMAGE_H_INC__
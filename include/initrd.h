@@ -9,6 +9,7 @@
 #define __LOLI_INITRD_H_INC__
 
 int initrd_setup(void *base, size_t size);
+void initrd_remove(void);
 
 #endif	// __LOLI_INITRD_H_INC__
 
@@ -15,9 +15,59 @@
 void *malloc_type(size_t size, Efi_Memory_Type type);
 void *malloc(size_t s);
 void free(void *p);
-void *realloc_type(void *p, Efi_Memory_Type type, size_t oldSize, size_t size);
-void *realloc(void *p, size_t oldSize, size_t size);
+size_t malloc_capacity(const void *p);
+void *realloc_type(void *p, Efi_Memory_Type type, size_t size);
+void *realloc(void *p, size_t size);
+void *realloc_grow(void *p, size_t size);
+
+#define MEMORY_ADDRESS_ANY	(~(uint64_t)0)
 
 void *malloc_pages(size_t size);
+void *malloc_pages_at(uint64_t address, size_t size);
+void *malloc_pages_aligned(size_t size, size_t align, uint64_t maxAddress);
 void free_pages(void *p, size_t size);
+
+typedef struct {
+	void *region;
+	size_t used;
+} Arena_Mark;
+
+void *arena_alloc(size_t size);
+char *arena_strndup(const char *s, size_t len);
+Arena_Mark arena_mark(void);
+void arena_reset(Arena_Mark mark);
+void arena_fini(void);
+
+void memory_report(void);
+
+#ifdef LOLI_MEMTRACK
+extern const char *gMemTag;
+
+/* Tag every allocation with its call site */
+#ifndef LOLI_MEMORY_INTERNAL
+
+#define MEMTRACK_STR_(x)	#x
+#define MEMTRACK_STR(x)		MEMTRACK_STR_(x)
+#define MEMTRACK_TAG		__FILE__ ":" MEMTRACK_STR(__LINE__)
+
+#define malloc_type(size, type) \
+	(gMemTag = MEMTRACK_TAG, malloc_type(size, type))
+#define malloc(size) \
+	(gMemTag = MEMTRACK_TAG, malloc(size))
+#define realloc_type(p, type, size) \
+	(gMemTag = MEMTRACK_TAG, realloc_type(p, type, size))
+#define realloc(p, size) \
+	(gMemTag = MEMTRACK_TAG, realloc(p, size))
+#define realloc_grow(p, size) \
+	(gMemTag = MEMTRACK_TAG, realloc_grow(p, size))
+#define malloc_pages(size) \
+	(gMemTag = MEMTRACK_TAG, malloc_pages(size))
+#define malloc_pages_at(address, size) \
+	(gMemTag = MEMTRACK_TAG, malloc_pages_at(address, size))
+#define malloc_pages_aligned(size, align, maxAddress) \
+	(gMemTag = MEMTRACK_TAG, malloc_pages_aligned(size, align, maxAddress))
+
+#endif	// LOLI_MEMORY_INTERNAL
+#endif	// LOLI_MEMTRACK
+
 #endif	// __LOLI_MEMORY_H_INC__
@@ -8,8 +8,22 @@
 #ifndef __LOLI_MENU_H_INC__
 #define __LOLI_MENU_H_INC__
 
-int menu_get_timeout(const char *cfg);
-const char *menu_get_nth_entry(const char *cfg, int index);
-char *menu_get_pair(const char *entry, const char *key);
+#include <extlinux.h>
+#include <file.h>
+
+typedef struct {
+	Extlinux_Index index;
+
+	/* Boot Loader Specification entries, values of the index point here */
+	File_Load_Request *blsFiles;
+	size_t blsNum;
+} Menu;
+
+void menu_load(Menu *menu, const Extlinux_Pair *pairs,
+	       unsigned long int pairNum);
+void menu_free(Menu *menu);
+int menu_get_timeout(const Menu *menu);
+const Extlinux_Entry *menu_get_nth_entry(const Menu *menu, int index);
+char *menu_get_pair(const Extlinux_Entry *entry, Extlinux_Key key);
 
 #endif	// __LOLI_MENU_H_INC__
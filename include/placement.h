@@ -0,0 +1,22 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/include/placement.h
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#ifndef __LOLI_PLACEMENT_H_INC__
+#define __LOLI_PLACEMENT_H_INC__
+
+#include <efidef.h>
+
+typedef enum {
+	PLACEMENT_ANY,
+	PLACEMENT_LOW,
+	PLACEMENT_HIGH,
+} Placement_Hint;
+
+void *placement_alloc(size_t size, size_t align, Placement_Hint hint);
+void placement_dump(void);
+
+#endif	// __LOLI_PLACEMENT_H_INC__
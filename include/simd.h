@@ -0,0 +1,39 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/include/simd.h
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#ifndef __LOLI_SIMD_H_INC__
+#define __LOLI_SIMD_H_INC__
+
+#include <efidef.h>
+#include <string.h>
+
+/*
+ * Bulk copy and fill of large buffers with FP/SIMD registers, built only
+ * with SIMD set. Smaller buffers are passed to memmove() and memset(), which
+ * are used for everything when SIMD routines are disabled. simd_copy() allows
+ * overlapping buffers as long as dst is below src.
+ */
+#ifdef LOLI_SIMD
+
+#ifdef LOLI_TARGET_X86_64
+/* Callers may run on behalf of firmware, which expects xmm6-15 preserved */
+#define SIMD_ABI	__attribute__((ms_abi))
+#else
+#define SIMD_ABI
+#endif
+
+SIMD_ABI void *simd_copy(void *dst, const void *src, size_t n);
+SIMD_ABI void *simd_fill(void *dst, int c, size_t n);
+
+#else
+
+#define simd_copy	memmove
+#define simd_fill	memset
+
+#endif	// LOLI_SIMD
+
+#endif	// __LOLI_SIMD_H_INC__
@@ -18,6 +18,7 @@ int strncmp(const char *s1, const char *s2, size_t n);
 
 size_t wcslen(const wchar_t *p);
 wchar_t *wcscpy(wchar_t *dst, const wchar_t *src);
+int wcscmp(const wchar_t *s1, const wchar_t *s2);
 
 size_t wcs2str(char *str, const wchar_t *wcs);
 size_t str2wcs(wchar_t *wcs, const char *str);
@@ -31,6 +32,6 @@ int atou(const char *p);
 
 size_t strscpy(char *dst, const char *src, size_t len);
 
-int memcmp(void *a, void *b, size_t len);
+int memcmp(const void *a, const void *b, size_t len);
 
 #endif	// __LOLI_STRING_H_INC__
@@ -0,0 +1,18 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/include/timer.h
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#ifndef __LOLI_TIMER_H_INC__
+#define __LOLI_TIMER_H_INC__
+
+#include <efidef.h>
+
+uint64_t timer_read(void);
+uint64_t timer_frequency(void);
+uint64_t timer_to_us(uint64_t ticks);
+uint64_t timer_to_ns(uint64_t ticks);
+
+#endif	// __LOLI_TIMER_H_INC__
@@ -0,0 +1,190 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/src/bench.c
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#include <efidef.h>
+#include <memory.h>
+#include <string.h>
+
+#include <bench.h>
+#include <file.h>
+#include <misc.h>
+#include <timer.h>
+
+#define BENCH_ROUNDS		3
+#define BENCH_CHUNK_MAX		(4 * 1024 * 1024)
+
+typedef enum {
+	BENCH_SEQUENTIAL,
+	BENCH_BACKWARD,
+	BENCH_RANDOM,
+	BENCH_PATTERN_NUM,
+} Bench_Pattern;
+
+static const char *patternNames[BENCH_PATTERN_NUM] = {
+	[BENCH_SEQUENTIAL]	= "seq",
+	[BENCH_BACKWARD]	= "back",
+	[BENCH_RANDOM]		= "rand",
+};
+
+/* 0 stands for reading the whole file with one request */
+static const size_t chunkSizes[] = {
+	4096, 16384, 65536, 262144, 1048576, BENCH_CHUNK_MAX, 0,
+};
+#define BENCH_CHUNK_SIZE_NUM	(sizeof(chunkSizes) / sizeof(chunkSizes[0]))
+
+typedef struct {
+	uint64_t bytes;
+	uint64_t ns;
+	uint64_t requests;
+	/* Latency of every request, in ns */
+	uint64_t *latency;
+} Bench_Result;
+
+static uint64_t
+bench_random(uint64_t *state)
+{
+	*state ^= *state << 13;
+	*state ^= *state >> 7;
+	*state ^= *state << 17;
+	return *state;
+}
+
+/*
+ * Read the file once in chunks of chunkSize following pattern, recording
+ * latency of each request into res. A round reads as many chunks as the file
+ * contains, random rounds may visit a chunk more than once.
+ */
+static int
+bench_round(File_Stream *s, void *buf, size_t chunkSize, Bench_Pattern pattern,
+	    Bench_Result *res)
+{
+	uint64_t chunkNum = (s->size + chunkSize - 1) / chunkSize;
+	uint64_t seed = 0x9e3779b97f4a7c15;
+
+	for (uint64_t i = 0; i < chunkNum; i++) {
+		uint64_t index = pattern == BENCH_SEQUENTIAL ? i :
+				 pattern == BENCH_BACKWARD ? chunkNum - i - 1 :
+				 bench_random(&seed) % chunkNum;
+		uint64_t offset = index * chunkSize;
+		size_t size = s->size - offset < chunkSize ?
+				s->size - offset : chunkSize;
+
+		uint64_t start = timer_read();
+		if (file_stream_seek(s, offset) ||
+		    file_stream_read(s, buf, size) != (int64_t)size)
+			return -1;
+		uint64_t ns = timer_to_ns(timer_read() - start);
+
+		res->latency[res->requests++] = ns;
+		res->ns		+= ns;
+		res->bytes	+= size;
+	}
+
+	return 0;
+}
+
+static void
+bench_report(size_t chunkSize, Bench_Pattern pattern, Bench_Result *res)
+{
+	uint64_t mean = res->ns / res->requests;
+	uint64_t variance = 0;
+
+	for (uint64_t i = 0; i < res->requests; i++) {
+		uint64_t d = res->latency[i] > mean ? res->latency[i] - mean :
+						      mean - res->latency[i];
+		/* Accumulate in us^2 to stay away from overflowing */
+		variance += d * d / 1000000;
+	}
+	variance /= res->requests;
+
+	/* bytes per us equals to MB/s */
+	uint64_t us = res->ns / 1000 ? res->ns / 1000 : 1;
+	uint64_t rate = res->bytes * 10 / us;
+
+	printf("%lu\t%s\t%lu.%lu MB/s\tlat %lu us\tvar %lu us^2\t%lu reqs\n",
+	       chunkSize, patternNames[pattern], rate / 10, rate % 10,
+	       mean / 1000, variance, res->requests);
+}
+
+/*
+ * Read path repeatedly with a sweep of chunk sizes and access patterns,
+ * then print throughput, average latency and variance of latency of each
+ * combination. Return 0 if all runs succeed, otherwise -1.
+ */
+int
+bench_file(const char *path)
+{
+	File_Stream s;
+
+	if (file_stream_open(&s, path, 0)) {
+		pr_err("Can't open benchmark file %s\n", path);
+		return -1;
+	}
+
+	if (!s.size) {
+		pr_err("Benchmark file %s is empty\n", path);
+		file_stream_close(&s);
+		return -1;
+	}
+
+	size_t bufSize = s.size < BENCH_CHUNK_MAX ? s.size : BENCH_CHUNK_MAX;
+	void *buf = malloc_pages(bufSize);
+	if (!buf) {
+		pr_err("Unable to allocate benchmark buffer\n");
+		file_stream_close(&s);
+		return -1;
+	}
+
+	pr_info("Benchmarking %s, size = %lu, %d rounds each\n",
+		path, s.size, BENCH_ROUNDS);
+	printf("chunk\tpattern\tthroughput\tlatency\tvariance\trequests\n");
+
+	int ret = 0;
+	for (size_t i = 0; i < BENCH_CHUNK_SIZE_NUM; i++) {
+		size_t chunkSize = chunkSizes[i];
+
+		/* The whole file is read with one request, in buf */
+		if (!chunkSize) {
+			if (s.size > bufSize)
+				continue;
+			chunkSize = s.size;
+		} else if (chunkSize > bufSize) {
+			continue;
+		}
+
+		uint64_t chunkNum = (s.size + chunkSize - 1) / chunkSize;
+
+		for (int p = 0; p < BENCH_PATTERN_NUM; p++) {
+			/* Patterns make no difference with a single chunk */
+			if (chunkNum == 1 && p != BENCH_SEQUENTIAL)
+				continue;
+
+			Bench_Result res = {
+				.latency = malloc(chunkNum * BENCH_ROUNDS *
+						  sizeof(uint64_t)),
+			};
+
+			for (int r = 0; r < BENCH_ROUNDS && !ret; r++)
+				ret = bench_round(&s, buf, chunkSize, p, &res);
+
+			if (!ret)
+				bench_report(chunkSize, p, &res);
+
+			free(res.latency);
+
+			if (ret) {
+				pr_err("Failed to read %s\n", path);
+				goto out;
+			}
+		}
+	}
+
+out:
+	free_pages(buf, bufSize);
+	file_stream_close(&s);
+	return ret;
+}
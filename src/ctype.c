@@ -10,3 +10,21 @@ isprint(int c)
 {
 	return c > 0x1f && c < 0x7f;
 }
+
+int
+isdigit(int c)
+{
+	return c >= '0' && c <= '9';
+}
+
+int
+tolower(int c)
+{
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+int
+toupper(int c)
+{
+	return c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c;
+}
@@ -9,6 +9,7 @@
 #include <eficall.h>
 #include <efi.h>
 #include <file.h>
+#include <string.h>
 
 Efi_System_Table *gST;
 Efi_Boot_Services *gBS;
@@ -23,3 +24,20 @@ void efi_init(Efi_Handle imageHandle, Efi_System_Table *st)
 	file_init();
 }
 
+
+/*
+ * Return the configuration table installed with guid, or NULL if there's
+ * none.
+ */
+void *
+efi_get_configuration_table(Efi_Guid guid)
+{
+	for (uint_native i = 0; i < gST->numberOfTableEntries; i++) {
+		Efi_Configuration_Table *t = &gST->configurationTable[i];
+
+		if (!memcmp(&t->vendorGuid, &guid, sizeof(guid)))
+			return t->vendorTable;
+	}
+
+	return NULL;
+}
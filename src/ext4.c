@@ -0,0 +1,855 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/src/ext4.c
+ *	Copyright (c) 2025 Yao Zi.
+ *	Read-only ext4 driver on top of EFI_DISK_IO_PROTOCOL.
+ */
+
+#include <efidef.h>
+#include <eficall.h>
+#include <efi.h>
+#include <efiboot.h>
+#include <efimedia.h>
+#include <memory.h>
+#include <string.h>
+#include <misc.h>
+
+#include <ext4.h>
+
+#define EXT4_SUPERBLOCK_OFFSET		1024
+#define EXT4_SUPERBLOCK_SIZE		1024
+#define EXT4_MAGIC			0xef53
+#define EXT4_ROOT_INO			2
+
+#define EXT4_INCOMPAT_FILETYPE		0x0002
+#define EXT4_INCOMPAT_RECOVER		0x0004
+#define EXT4_INCOMPAT_EXTENTS		0x0040
+#define EXT4_INCOMPAT_64BIT		0x0080
+#define EXT4_INCOMPAT_MMP		0x0100
+#define EXT4_INCOMPAT_FLEX_BG		0x0200
+#define EXT4_INCOMPAT_EA_INODE		0x0400
+#define EXT4_INCOMPAT_CSUM_SEED		0x2000
+#define EXT4_INCOMPAT_LARGEDIR		0x4000
+#define EXT4_INCOMPAT_INLINE_DATA	0x8000
+#define EXT4_INCOMPAT_ENCRYPT		0x10000
+#define EXT4_INCOMPAT_CASEFOLD		0x20000
+/*
+ * RECOVER isn't supported: with the journal unreplayed, inodes and extents
+ * on disk may be stale, see ext4_report().
+ *
+ * With INLINE_DATA and ENCRYPT, only the files using them can't be read, and
+ * are refused when opened. CASEFOLD isn't supported, since names are looked
+ * up by exact match, which may miss files in case-insensitive directories.
+ */
+#define EXT4_INCOMPAT_SUPPORTED	(EXT4_INCOMPAT_FILETYPE		|	\
+				 EXT4_INCOMPAT_EXTENTS		|	\
+				 EXT4_INCOMPAT_64BIT		|	\
+				 EXT4_INCOMPAT_MMP		|	\
+				 EXT4_INCOMPAT_FLEX_BG		|	\
+				 EXT4_INCOMPAT_EA_INODE		|	\
+				 EXT4_INCOMPAT_CSUM_SEED	|	\
+				 EXT4_INCOMPAT_LARGEDIR		|	\
+				 EXT4_INCOMPAT_INLINE_DATA	|	\
+				 EXT4_INCOMPAT_ENCRYPT)
+
+#define EXT4_S_IFMT			0xf000
+#define EXT4_S_IFDIR			0x4000
+#define EXT4_S_IFREG			0x8000
+#define EXT4_S_IFLNK			0xa000
+
+#define EXT4_ENCRYPT_FL			0x00000800
+#define EXT4_EXTENTS_FL			0x00080000
+#define EXT4_INLINE_DATA_FL		0x10000000
+
+#define EXT4_EXTENT_MAGIC		0xf30a
+#define EXT4_EXTENT_DEPTH_MAX		5
+#define EXT4_EXTENT_UNINIT		32768
+
+#define EXT4_N_BLOCKS_SIZE		60
+#define EXT4_NAME_MAX			255
+#define EXT4_SYMLINK_MAX		8
+#define EXT4_SYMLINK_SIZE_MAX		4096
+
+/*
+ * Contiguous bytes of a file on disk. Holes and uninitialized extents have a
+ * zero offset, and are read as zeros.
+ */
+typedef struct {
+	uint64_t logical;
+	uint64_t offset;
+	uint64_t length;
+} Ext4_Run;
+
+typedef struct {
+	Efi_Disk_Io_Protocol *diskIo;
+	uint32_t mediaId;
+
+	uint32_t blockSize;
+	uint32_t inodeSize;
+	uint32_t inodeNum;
+	uint32_t inodesPerGroup;
+	uint32_t descSize;
+	uint64_t gdtOffset;
+} Ext4_Volume;
+
+typedef struct {
+	uint16_t mode;
+	uint32_t flags;
+	uint64_t size;
+	uint8_t block[EXT4_N_BLOCKS_SIZE];
+} Ext4_Inode;
+
+typedef struct {
+	uint32_t ino;
+	uint8_t nameLen;
+	char name[EXT4_NAME_MAX + 1];
+} Ext4_Dirent;
+
+typedef struct {
+	Efi_File_Protocol protocol;
+	Ext4_Volume *vol;
+	uint32_t ino;
+	Ext4_Inode inode;
+	wchar_t *name;
+
+	uint64_t position;
+	Ext4_Run *runs;
+	size_t runNum;
+
+	/* Cached content, for directories only */
+	uint8_t *dirData;
+} Ext4_File;
+
+Efi_Status ext4_file_open(Efi_File_Protocol *this,
+			  Efi_File_Protocol **newHandle,
+			  wchar_t *fileName, uint64_t openMode,
+			  uint64_t attributes);
+Efi_Status ext4_file_close(Efi_File_Protocol *this);
+Efi_Status ext4_file_read(Efi_File_Protocol *this, uint_native *bufSize,
+			  void *buf);
+Efi_Status ext4_file_get_position(Efi_File_Protocol *this,
+				  uint64_t *position);
+Efi_Status ext4_file_set_position(Efi_File_Protocol *this,
+				  uint64_t position);
+Efi_Status ext4_file_get_info(Efi_File_Protocol *this, Efi_Guid *type,
+			      uint_native *bufSize, void *buf);
+
+static uint16_t
+le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t
+le32(const uint8_t *p)
+{
+	return le16(p) | ((uint32_t)le16(p + 2) << 16);
+}
+
+static int
+disk_read(Ext4_Volume *vol, uint64_t offset, uint64_t size, void *buf)
+{
+	return efi_method(vol->diskIo, readDisk, vol->mediaId,
+			  offset, size, buf) != EFI_SUCCESS;
+}
+
+static int
+ext4_read_inode(Ext4_Volume *vol, uint32_t ino, Ext4_Inode *inode)
+{
+	if (!ino || ino > vol->inodeNum)
+		return -1;
+
+	uint32_t group = (ino - 1) / vol->inodesPerGroup;
+	uint32_t index = (ino - 1) % vol->inodesPerGroup;
+
+	uint8_t desc[64];
+	if (disk_read(vol, vol->gdtOffset + (uint64_t)group * vol->descSize,
+		      vol->descSize, desc))
+		return -1;
+
+	uint64_t table = le32(desc + 0x08);
+	if (vol->descSize >= 64)
+		table |= (uint64_t)le32(desc + 0x28) << 32;
+
+	uint8_t raw[128];
+	if (disk_read(vol, table * vol->blockSize +
+			   (uint64_t)index * vol->inodeSize,
+		      sizeof(raw), raw))
+		return -1;
+
+	inode->mode	= le16(raw + 0x00);
+	inode->flags	= le32(raw + 0x20);
+	inode->size	= le32(raw + 0x04) | (uint64_t)le32(raw + 0x6c) << 32;
+	memcpy(inode->block, raw + 0x28, EXT4_N_BLOCKS_SIZE);
+
+	return 0;
+}
+
+static void
+ext4_add_run(Ext4_File *f, uint64_t logical, uint64_t offset, uint64_t length)
+{
+	Ext4_Run *last = f->runNum ? &f->runs[f->runNum - 1] : NULL;
+
+	if (last && last->logical + last->length == logical &&
+	    ((!last->offset && !offset) ||
+	     (last->offset && last->offset + last->length == offset))) {
+		last->length += length;
+		return;
+	}
+
+	f->runs = realloc_grow(f->runs, (f->runNum + 1) * sizeof(*f->runs));
+	f->runs[f->runNum++] = (Ext4_Run) { logical, offset, length };
+}
+
+/*
+ * Walk an extent tree node, and turn all extents below it into runs. Extents
+ * adjacent both in the file and on disk are merged, and later read with a
+ * single request.
+ */
+static int
+ext4_walk_extents(Ext4_File *f, const uint8_t *node, size_t nodeSize,
+		  int depth)
+{
+	Ext4_Volume *vol = f->vol;
+	uint16_t entries = le16(node + 2);
+
+	if (le16(node) != EXT4_EXTENT_MAGIC || le16(node + 6) != depth ||
+	    12 + (size_t)entries * 12 > nodeSize)
+		return -1;
+
+	for (int i = 0; i < entries; i++) {
+		const uint8_t *e = node + 12 + i * 12;
+
+		if (!depth) {
+			uint64_t logical = le32(e);
+			uint32_t len = le16(e + 4);
+			uint64_t start = (uint64_t)le16(e + 6) << 32 |
+					 le32(e + 8);
+
+			int uninit = len > EXT4_EXTENT_UNINIT;
+			if (uninit)
+				len -= EXT4_EXTENT_UNINIT;
+
+			ext4_add_run(f, logical * vol->blockSize,
+				     uninit ? 0 : start * vol->blockSize,
+				     (uint64_t)len * vol->blockSize);
+			continue;
+		}
+
+		uint64_t leaf = (uint64_t)le16(e + 8) << 32 | le32(e + 4);
+		uint8_t *child = malloc(vol->blockSize);
+
+		int ret = disk_read(vol, leaf * vol->blockSize,
+				    vol->blockSize, child) ||
+			  ext4_walk_extents(f, child, vol->blockSize,
+					    depth - 1);
+		free(child);
+
+		if (ret)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int
+ext4_is_fast_symlink(const Ext4_Inode *inode)
+{
+	return (inode->mode & EXT4_S_IFMT) == EXT4_S_IFLNK &&
+	       !(inode->flags & EXT4_EXTENTS_FL) &&
+	       inode->size < EXT4_N_BLOCKS_SIZE;
+}
+
+static void
+ext4_file_free(Ext4_File *f)
+{
+	free(f->runs);
+	free(f->dirData);
+	free(f->name);
+	free(f);
+}
+
+static Ext4_File *
+ext4_file_new(Ext4_Volume *vol, uint32_t ino, const wchar_t *name,
+	      size_t nameLen)
+{
+	Ext4_File *f = malloc(sizeof(*f));
+
+	*f = (Ext4_File) {
+		.protocol	= {
+			.revision	= EFI_FILE_PROTOCOL_REVISION,
+			.open		= ext4_file_open,
+			.close		= ext4_file_close,
+			.read		= ext4_file_read,
+			.getPosition	= ext4_file_get_position,
+			.setPosition	= ext4_file_set_position,
+			.getInfo	= ext4_file_get_info,
+		},
+		.vol		= vol,
+		.ino		= ino,
+		.name		= malloc((nameLen + 1) * sizeof(wchar_t)),
+	};
+
+	memcpy(f->name, name, nameLen * sizeof(wchar_t));
+	f->name[nameLen] = 0;
+
+	if (ext4_read_inode(vol, ino, &f->inode))
+		goto err;
+
+	uint16_t type = f->inode.mode & EXT4_S_IFMT;
+	if (type != EXT4_S_IFDIR && type != EXT4_S_IFREG &&
+	    type != EXT4_S_IFLNK)
+		goto err;
+
+	/* Data of fast symlinks lives in the inode directly */
+	if (ext4_is_fast_symlink(&f->inode))
+		return f;
+
+	if (f->inode.flags & (EXT4_ENCRYPT_FL | EXT4_INLINE_DATA_FL) ||
+	    !(f->inode.flags & EXT4_EXTENTS_FL))
+		goto err;
+
+	uint16_t depth = le16(f->inode.block + 6);
+	if (depth > EXT4_EXTENT_DEPTH_MAX ||
+	    ext4_walk_extents(f, f->inode.block, EXT4_N_BLOCKS_SIZE, depth))
+		goto err;
+
+	return f;
+
+err:
+	ext4_file_free(f);
+	return NULL;
+}
+
+static int
+ext4_read_runs(Ext4_File *f, uint64_t pos, void *buf, uint64_t size)
+{
+	uint8_t *p = buf;
+	uint64_t cur = pos, end = pos + size;
+
+	if (ext4_is_fast_symlink(&f->inode)) {
+		memcpy(buf, f->inode.block + pos, size);
+		return 0;
+	}
+
+	for (size_t i = 0; i < f->runNum && cur < end; i++) {
+		Ext4_Run *run = &f->runs[i];
+
+		if (run->logical + run->length <= cur)
+			continue;
+
+		if (run->logical >= end)
+			break;
+
+		/* Sparse region between extents */
+		if (run->logical > cur) {
+			memset(p + (cur - pos), 0, run->logical - cur);
+			cur = run->logical;
+		}
+
+		uint64_t runEnd = run->logical + run->length;
+		uint64_t n = (runEnd < end ? runEnd : end) - cur;
+
+		if (!run->offset)
+			memset(p + (cur - pos), 0, n);
+		else if (disk_read(f->vol, run->offset + (cur - run->logical),
+				   n, p + (cur - pos)))
+			return -1;
+
+		cur += n;
+	}
+
+	if (cur < end)
+		memset(p + (cur - pos), 0, end - cur);
+
+	return 0;
+}
+
+static int
+ext4_is_dir(Ext4_File *f)
+{
+	return (f->inode.mode & EXT4_S_IFMT) == EXT4_S_IFDIR;
+}
+
+static int
+ext4_load_dir(Ext4_File *dir)
+{
+	if (dir->dirData)
+		return 0;
+
+	/*
+	 * Records never span blocks, and a corrupted size mustn't make us
+	 * allocate more than the directory takes on disk.
+	 */
+	uint64_t mapped = 0;
+	for (size_t i = 0; i < dir->runNum; i++)
+		mapped += dir->runs[i].length;
+
+	if (!dir->inode.size || dir->inode.size % dir->vol->blockSize ||
+	    dir->inode.size > mapped)
+		return -1;
+
+	dir->dirData = malloc(dir->inode.size);
+	if (ext4_read_runs(dir, 0, dir->dirData, dir->inode.size)) {
+		free(dir->dirData);
+		dir->dirData = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Retrieve the next entry of a loaded directory, starting from byte offset
+ * *pos, which is then updated to point after the entry.
+ *
+ * Hashed (htree) directories are scanned linearly as well: their index blocks
+ * look like empty entries spanning whole blocks, and are skipped naturally.
+ *
+ * Return 0 if an entry is found, or -1 at the end of directory.
+ */
+static int
+ext4_dir_next(Ext4_File *dir, uint64_t *pos, Ext4_Dirent *dirent)
+{
+	uint32_t blockSize = dir->vol->blockSize;
+
+	while (*pos + 8 <= dir->inode.size) {
+		const uint8_t *e = dir->dirData + *pos;
+		uint64_t blockEnd = (*pos / blockSize + 1) * blockSize;
+		if (blockEnd > dir->inode.size)
+			blockEnd = dir->inode.size;
+		uint32_t ino = le32(e);
+		uint16_t recLen = le16(e + 4);
+		uint8_t nameLen = e[6];
+
+		/* Skip the rest of a corrupted block */
+		if (recLen < 8 || recLen % 4 || *pos + recLen > blockEnd ||
+		    8 + nameLen > recLen) {
+			*pos = blockEnd;
+			continue;
+		}
+
+		*pos += recLen;
+
+		if (!ino || !nameLen)
+			continue;
+
+		dirent->ino	= ino;
+		dirent->nameLen	= nameLen;
+		memcpy(dirent->name, e + 8, nameLen);
+		dirent->name[nameLen] = '\0';
+
+		return 0;
+	}
+
+	return -1;
+}
+
+static int
+ext4_lookup(Ext4_File *dir, const wchar_t *name, size_t len,
+	    Ext4_Dirent *dirent)
+{
+	if (!ext4_is_dir(dir) || ext4_load_dir(dir))
+		return 0;
+
+	uint64_t pos = 0;
+	while (!ext4_dir_next(dir, &pos, dirent)) {
+		if (dirent->nameLen != len)
+			continue;
+
+		size_t i;
+		for (i = 0; i < len && name[i] == (uint8_t)dirent->name[i]; i++)
+			;
+
+		if (i == len)
+			return 1;
+	}
+
+	return 0;
+}
+
+/*
+ * Splice the target of symlink in front of rest, with '/' translated to '\'.
+ *
+ * Return the new path, or NULL if the symlink can't be read.
+ */
+static wchar_t *
+ext4_splice_symlink(Ext4_File *link, const wchar_t *rest)
+{
+	uint64_t size = link->inode.size;
+	if (!size || size > EXT4_SYMLINK_SIZE_MAX)
+		return NULL;
+
+	char *target = malloc(size);
+	if (ext4_read_runs(link, 0, target, size)) {
+		free(target);
+		return NULL;
+	}
+
+	size_t restLen = wcslen(rest);
+	wchar_t *path = malloc((size + 1 + restLen + 1) * sizeof(wchar_t));
+
+	for (uint64_t i = 0; i < size; i++)
+		path[i] = target[i] == '/' ? '\\' : (uint8_t)target[i];
+	path[size] = '\\';
+	wcscpy(path + size + 1, rest);
+
+	free(target);
+	return path;
+}
+
+Efi_Status
+efi_callback(ext4_file_open)(Efi_File_Protocol *this,
+			     Efi_File_Protocol **newHandle,
+			     wchar_t *fileName, uint64_t openMode,
+			     uint64_t attributes)
+{
+	Ext4_File *cur = (Ext4_File *)this;
+	Ext4_Volume *vol = cur->vol;
+	(void)attributes;
+
+	if (!newHandle || !fileName)
+		return TO_EFI_ERRNO(EFI_INVALID_PARAMETER);
+
+	if (openMode != EFI_FILE_MODE_READ)
+		return TO_EFI_ERRNO(EFI_WRITE_PROTECTED);
+
+	wchar_t *path = malloc((wcslen(fileName) + 1) * sizeof(wchar_t));
+	wcscpy(path, fileName);
+
+	const wchar_t *p = path;
+	Ext4_File *f = *p == '\\' ?
+			ext4_file_new(vol, EXT4_ROOT_INO, L"", 0) :
+			ext4_file_new(vol, cur->ino, cur->name,
+				      wcslen(cur->name));
+	int symlinks = 0;
+
+	while (f && *p) {
+		while (*p == '\\')
+			p++;
+
+		const wchar_t *end = p;
+		while (*end && *end != '\\')
+			end++;
+
+		size_t len = end - p;
+		if (!len || (len == 1 && p[0] == '.')) {
+			p = end;
+			continue;
+		}
+
+		Ext4_Dirent dirent;
+		Ext4_File *next = NULL;
+		if (ext4_lookup(f, p, len, &dirent))
+			next = ext4_file_new(vol, dirent.ino, p, len);
+
+		if (!next || (next->inode.mode & EXT4_S_IFMT) != EXT4_S_IFLNK) {
+			ext4_file_free(f);
+			f = next;
+			p = end;
+			continue;
+		}
+
+		/*
+		 * Follow the symlink by resolving its target in place of the
+		 * component, starting from the root for absolute targets or
+		 * from the directory containing the link otherwise.
+		 */
+		wchar_t *newPath = ++symlinks > EXT4_SYMLINK_MAX ? NULL :
+				   ext4_splice_symlink(next, end);
+		ext4_file_free(next);
+
+		if (!newPath) {
+			ext4_file_free(f);
+			f = NULL;
+			break;
+		}
+
+		free(path);
+		path = newPath;
+		p = path;
+
+		if (*p == '\\') {
+			ext4_file_free(f);
+			f = ext4_file_new(vol, EXT4_ROOT_INO, L"", 0);
+		}
+	}
+
+	free(path);
+
+	if (!f)
+		return TO_EFI_ERRNO(EFI_NOT_FOUND);
+
+	*newHandle = &f->protocol;
+	return EFI_SUCCESS;
+}
+
+Efi_Status
+efi_callback(ext4_file_close)(Efi_File_Protocol *this)
+{
+	ext4_file_free((Ext4_File *)this);
+	return EFI_SUCCESS;
+}
+
+static size_t
+ext4_fill_info(Ext4_Volume *vol, const Ext4_Inode *inode, const wchar_t *name,
+	       Efi_File_Info *info)
+{
+	size_t size = sizeof(*info) + (wcslen(name) + 1) * sizeof(wchar_t);
+
+	if (!info)
+		return size;
+
+	memset(info, 0, sizeof(*info));
+	info->size		= size;
+	info->fileSize		= inode->size;
+	info->physicalSize	= (inode->size + vol->blockSize - 1) /
+				  vol->blockSize * vol->blockSize;
+	info->attribute		= EFI_FILE_READ_ONLY;
+	if ((inode->mode & EXT4_S_IFMT) == EXT4_S_IFDIR)
+		info->attribute |= EFI_FILE_DIRECTORY;
+
+	wcscpy(info->fileName, name);
+
+	return size;
+}
+
+/*
+ * Reading a directory returns an Efi_File_Info for the next entry on each
+ * call, and a zero size at the end.
+ */
+static Efi_Status
+ext4_dir_read(Ext4_File *dir, uint_native *bufSize, void *buf)
+{
+	if (ext4_load_dir(dir))
+		return TO_EFI_ERRNO(EFI_DEVICE_ERROR);
+
+	uint64_t pos = dir->position;
+	Ext4_Dirent dirent;
+	Ext4_Inode inode;
+
+	if (ext4_dir_next(dir, &pos, &dirent)) {
+		dir->position	= pos;
+		*bufSize	= 0;
+		return EFI_SUCCESS;
+	}
+
+	if (ext4_read_inode(dir->vol, dirent.ino, &inode))
+		return TO_EFI_ERRNO(EFI_DEVICE_ERROR);
+
+	wchar_t name[EXT4_NAME_MAX + 1];
+	for (int i = 0; i <= dirent.nameLen; i++)
+		name[i] = (uint8_t)dirent.name[i];
+
+	size_t infoSize = ext4_fill_info(dir->vol, &inode, name, NULL);
+	if (*bufSize < infoSize) {
+		*bufSize = infoSize;
+		return TO_EFI_ERRNO(EFI_BUFFER_TOO_SMALL);
+	}
+
+	ext4_fill_info(dir->vol, &inode, name, buf);
+	*bufSize	= infoSize;
+	dir->position	= pos;
+
+	return EFI_SUCCESS;
+}
+
+Efi_Status
+efi_callback(ext4_file_read)(Efi_File_Protocol *this, uint_native *bufSize,
+			     void *buf)
+{
+	Ext4_File *f = (Ext4_File *)this;
+
+	if (ext4_is_dir(f))
+		return ext4_dir_read(f, bufSize, buf);
+
+	uint64_t fileSize = f->inode.size;
+	uint64_t remaining = f->position < fileSize ?
+				fileSize - f->position : 0;
+	uint64_t size = *bufSize < remaining ? *bufSize : remaining;
+
+	if (size && ext4_read_runs(f, f->position, buf, size))
+		return TO_EFI_ERRNO(EFI_DEVICE_ERROR);
+
+	f->position	+= size;
+	*bufSize	= size;
+
+	return EFI_SUCCESS;
+}
+
+Efi_Status
+efi_callback(ext4_file_get_position)(Efi_File_Protocol *this,
+				     uint64_t *position)
+{
+	Ext4_File *f = (Ext4_File *)this;
+
+	if (ext4_is_dir(f))
+		return TO_EFI_ERRNO(EFI_UNSUPPORTED);
+
+	*position = f->position;
+	return EFI_SUCCESS;
+}
+
+/*
+ * A directory only supports rewinding, for regular files ~0 seeks to the end.
+ */
+Efi_Status
+efi_callback(ext4_file_set_position)(Efi_File_Protocol *this,
+				     uint64_t position)
+{
+	Ext4_File *f = (Ext4_File *)this;
+
+	if (ext4_is_dir(f)) {
+		if (position)
+			return TO_EFI_ERRNO(EFI_UNSUPPORTED);
+	} else if (position == ~(uint64_t)0) {
+		position = f->inode.size;
+	}
+
+	f->position = position;
+	return EFI_SUCCESS;
+}
+
+Efi_Status
+efi_callback(ext4_file_get_info)(Efi_File_Protocol *this, Efi_Guid *type,
+				 uint_native *bufSize, void *buf)
+{
+	Ext4_File *f = (Ext4_File *)this;
+	Efi_Guid fileInfoGuid = EFI_FILE_INFO_GUID;
+
+	if (memcmp(type, &fileInfoGuid, sizeof(fileInfoGuid)))
+		return TO_EFI_ERRNO(EFI_UNSUPPORTED);
+
+	size_t infoSize = ext4_fill_info(f->vol, &f->inode, f->name, NULL);
+	if (*bufSize < infoSize) {
+		*bufSize = infoSize;
+		return TO_EFI_ERRNO(EFI_BUFFER_TOO_SMALL);
+	}
+
+	ext4_fill_info(f->vol, &f->inode, f->name, buf);
+	*bufSize = infoSize;
+
+	return EFI_SUCCESS;
+}
+
+/* Partitions not mounted for an unreplayed journal, see ext4_report() */
+static int recoverNum;
+
+static Ext4_Volume *
+ext4_mount(Efi_Handle device)
+{
+	Efi_Block_Io_Protocol *blockIo = NULL;
+	Efi_Disk_Io_Protocol *diskIo = NULL;
+
+	efi_handle_protocol(device, EFI_BLOCK_IO_PROTOCOL_GUID, &blockIo);
+	efi_handle_protocol(device, EFI_DISK_IO_PROTOCOL_GUID, &diskIo);
+
+	/* Only look for filesystems on partitions, but not whole disks */
+	if (!blockIo || !diskIo || !blockIo->media->mediaPresent ||
+	    !blockIo->media->logicalPartition)
+		return NULL;
+
+	Ext4_Volume tmp = {
+		.diskIo		= diskIo,
+		.mediaId	= blockIo->media->mediaId,
+	};
+
+	uint8_t *sb = malloc(EXT4_SUPERBLOCK_SIZE);
+	if (disk_read(&tmp, EXT4_SUPERBLOCK_OFFSET, EXT4_SUPERBLOCK_SIZE, sb))
+		goto err;
+
+	uint32_t incompat = le32(sb + 0x60);
+	uint32_t logBlockSize = le32(sb + 0x18);
+	if (le16(sb + 0x38) != EXT4_MAGIC)
+		goto err;
+
+	if (incompat & EXT4_INCOMPAT_RECOVER) {
+		recoverNum++;
+		goto err;
+	}
+
+	if (incompat & ~EXT4_INCOMPAT_SUPPORTED || logBlockSize > 6)
+		goto err;
+
+	tmp.blockSize		= 1024 << logBlockSize;
+	tmp.inodeNum		= le32(sb + 0x00);
+	tmp.inodesPerGroup	= le32(sb + 0x28);
+	tmp.inodeSize		= le32(sb + 0x4c) ? le16(sb + 0x58) : 128;
+	tmp.descSize		= incompat & EXT4_INCOMPAT_64BIT ?
+					le16(sb + 0xfe) : 32;
+	tmp.gdtOffset		= ((uint64_t)le32(sb + 0x14) + 1) *
+				  tmp.blockSize;
+
+	if (!tmp.inodesPerGroup || tmp.inodeSize < 128 ||
+	    tmp.inodeSize > tmp.blockSize ||
+	    tmp.descSize < 32 || tmp.descSize > 64)
+		goto err;
+
+	free(sb);
+
+	Ext4_Volume *vol = malloc(sizeof(*vol));
+	*vol = tmp;
+	return vol;
+
+err:
+	free(sb);
+	return NULL;
+}
+
+/*
+ * Mount all ext4 partitions found through Block I/O, and store handles of
+ * their root directories in roots, which holds at most max handles. Like
+ * fat_open_volume(), nothing is printed since the console isn't ready yet.
+ *
+ * Return number of mounted volumes.
+ */
+int
+ext4_open_volumes(Efi_File_Protocol **roots, int max)
+{
+	Efi_Guid blockIoGuid = EFI_BLOCK_IO_PROTOCOL_GUID;
+	uint_native size = 0;
+	Efi_Handle *handles;
+	int num = 0;
+
+	if (efi_call(gBS->locateHandle, Efi_Locate_By_Protocol, &blockIoGuid,
+		     NULL, &size, NULL) != TO_EFI_ERRNO(EFI_BUFFER_TOO_SMALL))
+		return 0;
+
+	handles = malloc(size);
+	if (efi_call(gBS->locateHandle, Efi_Locate_By_Protocol, &blockIoGuid,
+		     NULL, &size, handles) != EFI_SUCCESS)
+		goto out;
+
+	for (size_t i = 0; i < size / sizeof(*handles) && num < max; i++) {
+		Ext4_Volume *vol = ext4_mount(handles[i]);
+		if (!vol)
+			continue;
+
+		Ext4_File *root = ext4_file_new(vol, EXT4_ROOT_INO, L"", 0);
+		if (!root || !ext4_is_dir(root)) {
+			if (root)
+				ext4_file_free(root);
+			free(vol);
+			continue;
+		}
+
+		roots[num++] = &root->protocol;
+	}
+
+out:
+	free(handles);
+	return num;
+}
+
+/*
+ * Warn about partitions ext4_open_volumes() refused, once the console is
+ * ready.
+ */
+void
+ext4_report(void)
+{
+	if (recoverNum)
+		pr_warn("%d ext4 partition(s) ignored for journal recovery "
+			"needed, run fsck on them\n", recoverNum);
+}
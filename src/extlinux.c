@@ -8,6 +8,7 @@
 
 #include <string.h>
 
+#define EXTLINUX_KEYS_TABLE
 #include "extlinux.h"
 
 static int
@@ -97,6 +98,47 @@ match_key(const char *p, const char *key)
 	return NULL;
 }
 
+/*
+ * Given a line without leading white space characters as p, classify it by
+ * its first token with the hash table generated by tools/extlinuxkeys.py.
+ *
+ * Return the key if p is a valid k-v pair of a known key and store pointer to
+ * start of the value in value, otherwise -1.
+ */
+static int
+classify_line(const char *p, const char **value)
+{
+	const char *end = p;
+
+	while (*end && *end != '\n' && !is_space(end))
+		end++;
+
+	if (end == p)
+		return -1;
+
+	int h = EXTLINUX_KEY_HASH((unsigned char)p[0], (unsigned char)end[-1],
+				  end - p);
+
+	/* Keys sharing the first token, like "menu title", are tried in turn */
+	for (int i = 0; i < keyHash[h].num; i++) {
+		int key = keyHash[h].key + i;
+
+		*value = match_key(p, keyNames[key]);
+		if (*value)
+			return key;
+	}
+
+	return -1;
+}
+
+static int
+is_label(const char *p)
+{
+	const char *value;
+
+	return classify_line(p, &value) == EXTLINUX_KEY_LABEL;
+}
+
 /*
  * Given string p, return pointer to the next line, or NULL if none.
  */
@@ -118,6 +160,29 @@ next_line(const char *p)
 	return *p ? p : NULL;
 }
 
+/*
+ * Given value as start of the value in a k-v pair, return its length with
+ * trailing white space characters stripped.
+ */
+static unsigned long int
+value_len(const char *value)
+{
+	const char *vend = value;
+
+	while (*vend && *vend != '\n')
+		vend++;
+	/*
+	 * At end of the loop, we're hitting either zero terminator or end of
+	 * line. Skip it.
+	 */
+	vend--;
+
+	while (vend >= value && is_space(vend))
+		vend--;
+
+	return vend - value + 1;
+}
+
 /*
  * Given extlinux configuration conf, and last as pointer to the last entry
  * processed, returns the next entry or NULL.
@@ -139,7 +204,7 @@ extlinux_next_entry(const char *conf, const char *last)
 	while (p) {
 		p = skip_space(p);
 
-		if (match_key(p, "label"))
+		if (is_label(p))
 			return p;
 
 		p = next_line(p);
@@ -162,8 +227,7 @@ extlinux_get_value(const char *p, const char *key, unsigned long int *valuelen)
 	 * "label" token implies end of an entry, thus we need to take care of
 	 * the special case of getting value for "label" pair.
 	 */
-	int getLabel = key[0] == 'l' && key[1] == 'a' && key[2] == 'b' &&
-		       key[3] == 'e' && key[4] == 'l' && !key[5];
+	int getLabel = !strcmp(key, keyNames[EXTLINUX_KEY_LABEL]);
 
 	/*
 	 * If we aren't looking up value for "label", and p does point to an
@@ -175,7 +239,7 @@ extlinux_get_value(const char *p, const char *key, unsigned long int *valuelen)
 	 * which case we'll miss the first global k-v pair if we skip the first
 	 * line.
 	 */
-	if (!getLabel && match_key(p, "label"))
+	if (!getLabel && is_label(p))
 		p = next_line(p);
 
 	const char *value = NULL;
@@ -192,7 +256,7 @@ extlinux_get_value(const char *p, const char *key, unsigned long int *valuelen)
 		 * If we're not looking up a "label" pair, hitting "label" key
 		 * simply means end of this entry, and we've found nothing.
 		 */
-		if (match_key(p, "label") && !getLabel)
+		if (!getLabel && is_label(p))
 			break;
 
 		value = match_key(p, key);
@@ -202,20 +266,7 @@ extlinux_get_value(const char *p, const char *key, unsigned long int *valuelen)
 			 * calculate the value length with trailing white space
 			 * stripped
 			 */
-			const char *vend = value;
-
-			while (*vend && *vend != '\n')
-				vend++;
-			/*
-			 * At end of the loop, we're hitting either zero
-			 * terminator or end of line. Skip it.
-			 */
-			vend--;
-
-			while (vend >= value && is_space(vend))
-				vend--;
-
-			*valuelen = vend - value + 1;
+			*valuelen = value_len(value);
 			return value;
 		}
 
@@ -224,3 +275,295 @@ extlinux_get_value(const char *p, const char *key, unsigned long int *valuelen)
 
 	return NULL;
 }
+
+const char *
+extlinux_key_name(Extlinux_Key key)
+{
+	return keyNames[key];
+}
+
+/*
+ * Prepare index for indexing configurations, storing at most entryMax entries
+ * in entries.
+ */
+void
+extlinux_index_init(Extlinux_Index *index, Extlinux_Entry *entries,
+		    unsigned long int entryMax)
+{
+	memset(&index->global, 0, sizeof(index->global));
+	index->entries	= entries;
+	index->entryMax	= entryMax;
+	index->entryNum	= 0;
+}
+
+/*
+ * Return the entry which pairs are currently stored to, or NULL if it doesn't
+ * fit in the index.
+ */
+static Extlinux_Entry *
+index_current(Extlinux_Index *index)
+{
+	if (!index->entryNum)
+		return &index->global;
+
+	if (index->entryNum > index->entryMax)
+		return NULL;
+
+	return &index->entries[index->entryNum - 1];
+}
+
+/*
+ * Record pair in the entry it belongs to, a "label" pair starts a new entry.
+ */
+static void
+index_apply(Extlinux_Index *index, const Extlinux_Pair *pair)
+{
+	if (pair->key == EXTLINUX_KEY_LABEL) {
+		index->entryNum++;
+
+		Extlinux_Entry *entry = index_current(index);
+		if (entry)
+			memset(entry, 0, sizeof(*entry));
+	}
+
+	Extlinux_Entry *entry = index_current(index);
+	if (!entry || entry->values[pair->key].value)
+		return;
+
+	entry->values[pair->key] = pair->value;
+}
+
+/*
+ * Index configuration conf in a single pass, recording the value of every
+ * known key in the entry it belongs to. Pairs before the first "label" are
+ * global options, or belong to the last entry indexed if conf isn't the first
+ * configuration added. Like extlinux_get_value(), the first pair of a key in
+ * an entry takes effect.
+ *
+ * Values point into conf, thus conf should live as long as the index. Entries
+ * are counted in entryNum even if they don't fit in the index, in which case
+ * indexing should be retried with a larger array.
+ */
+void
+extlinux_index_add(Extlinux_Index *index, const char *conf)
+{
+	for (const char *p = conf; p; p = next_line(p)) {
+		p = skip_space(p);
+
+		Extlinux_Pair pair;
+		int key = classify_line(p, &pair.value.value);
+		if (key < 0)
+			continue;
+
+		pair.key	= key;
+		pair.value.len	= value_len(pair.value.value);
+		index_apply(index, &pair);
+	}
+}
+
+/*
+ * Like extlinux_index_add(), but index pairs parsed by extlinux_parse().
+ */
+void
+extlinux_index_add_pairs(Extlinux_Index *index, const Extlinux_Pair *pairs,
+			 unsigned long int num)
+{
+	for (unsigned long int i = 0; i < num; i++)
+		index_apply(index, &pairs[i]);
+}
+
+/*
+ * Parse conf into a list of k-v pairs of known keys in order, storing at most
+ * pairMax of them in pairs. Parsed pairs could be indexed any number of times
+ * later without looking at the text again.
+ *
+ * Return the number of pairs in conf, which may be larger than pairMax.
+ */
+unsigned long int
+extlinux_parse(const char *conf, Extlinux_Pair *pairs,
+	       unsigned long int pairMax)
+{
+	unsigned long int num = 0;
+
+	for (const char *p = conf; p; p = next_line(p)) {
+		p = skip_space(p);
+
+		const char *value;
+		int key = classify_line(p, &value);
+		if (key < 0)
+			continue;
+
+		if (num < pairMax) {
+			pairs[num] = (Extlinux_Pair) {
+				.key	= key,
+				.value	= {
+					.value	= value,
+					.len	= value_len(value),
+				},
+			};
+		}
+		num++;
+	}
+
+	return num;
+}
+
+/*
+ * Index conf as exactly one entry labeled label, like a Boot Loader
+ * Specification entry. "label" pairs in conf are ignored instead of starting
+ * new entries. Return the entry, or NULL if it doesn't fit in the index.
+ */
+Extlinux_Entry *
+extlinux_index_add_entry(Extlinux_Index *index, const char *conf,
+			 const Extlinux_Value *label)
+{
+	index->entryNum++;
+
+	Extlinux_Entry *entry = index_current(index);
+	if (!entry)
+		return NULL;
+
+	memset(entry, 0, sizeof(*entry));
+	entry->values[EXTLINUX_KEY_LABEL] = *label;
+
+	for (const char *p = conf; p; p = next_line(p)) {
+		p = skip_space(p);
+
+		const char *value;
+		int key = classify_line(p, &value);
+		if (key < 0 || entry->values[key].value)
+			continue;
+
+		entry->values[key] = (Extlinux_Value) {
+			.value	= value,
+			.len	= value_len(value),
+		};
+	}
+
+	return entry;
+}
+
+static int
+is_digit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static int
+is_alpha(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+/*
+ * Rank of separators in versions, those with a lower rank sort first. Return
+ * zero if c isn't one.
+ */
+static int
+version_separator(char c)
+{
+	return c == '-' ? 1 :
+	       c == '^' ? 2 :
+	       c == '.' ? 3 : 0;
+}
+
+/*
+ * Characters other than these are skipped when comparing versions.
+ */
+static int
+is_version_char(char c)
+{
+	return is_digit(c) || is_alpha(c) || c == '~' || version_separator(c);
+}
+
+/*
+ * Compare versions a and b like the UAPI Version Format Specification, which
+ * the Boot Loader Specification follows:
+ *
+ * - '~' sorts before everything, even the end of the version, thus 6.1~rc1 is
+ *   older than 6.1.
+ * - Then a version ending first is the older one.
+ * - '-', '^' and '.' sort in order before alphanumeric characters.
+ * - Runs of letters sort before runs of digits. Letters are compared one by
+ *   one, and digits numerically.
+ *
+ * Return a negative value if a is older than b, positive if newer, or zero if
+ * they're equal.
+ */
+int
+extlinux_version_compare(const Extlinux_Value *a, const Extlinux_Value *b)
+{
+	const char *p = a->value, *pEnd = p + a->len;
+	const char *q = b->value, *qEnd = q + b->len;
+
+	while (1) {
+		while (p < pEnd && !is_version_char(*p))
+			p++;
+		while (q < qEnd && !is_version_char(*q))
+			q++;
+
+		char pc = p < pEnd ? *p : '\0';
+		char qc = q < qEnd ? *q : '\0';
+
+		if (!pc && !qc)
+			return 0;
+
+		if (pc == '~' || qc == '~') {
+			if (pc != qc)
+				return pc == '~' ? -1 : 1;
+
+			p++;
+			q++;
+			continue;
+		}
+
+		if (!pc || !qc)
+			return pc ? 1 : -1;
+
+		/* Separators sort before alphanumeric characters */
+		int ps = version_separator(pc), qs = version_separator(qc);
+		if (ps || qs) {
+			if (ps != qs)
+				return !qs || (ps && ps < qs) ? -1 : 1;
+
+			p++;
+			q++;
+			continue;
+		}
+
+		if (is_digit(pc) != is_digit(qc))
+			return is_digit(pc) ? 1 : -1;
+
+		const char *pRun = p, *qRun = q;
+		if (is_digit(pc)) {
+			while (p < pEnd && *p == '0')
+				p++;
+			while (q < qEnd && *q == '0')
+				q++;
+
+			pRun = p;
+			qRun = q;
+			while (p < pEnd && is_digit(*p))
+				p++;
+			while (q < qEnd && is_digit(*q))
+				q++;
+
+			/* The longer run of digits is the larger number */
+			if (p - pRun != q - qRun)
+				return p - pRun < q - qRun ? -1 : 1;
+		} else {
+			while (p < pEnd && is_alpha(*p))
+				p++;
+			while (q < qEnd && is_alpha(*q))
+				q++;
+		}
+
+		unsigned long int pLen = p - pRun, qLen = q - qRun;
+		int cmp = memcmp(pRun, qRun, pLen < qLen ? pLen : qLen);
+		if (cmp)
+			return cmp < 0 ? -1 : 1;
+
+		if (pLen != qLen)
+			return pLen < qLen ? -1 : 1;
+	}
+}
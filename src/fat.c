@@ -0,0 +1,777 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/src/fat.c
+ *	Copyright (c) 2025 Yao Zi.
+ *	Read-only FAT12/16/32 driver on top of EFI_DISK_IO_PROTOCOL.
+ */
+
+#include <ctype.h>
+#include <efidef.h>
+#include <eficall.h>
+#include <efi.h>
+#include <efiboot.h>
+#include <efimedia.h>
+#include <memory.h>
+#include <string.h>
+
+#include <fat.h>
+
+#define FAT_CACHE_LINE_SIZE	4096
+#define FAT_CACHE_LINES		16
+
+#define FAT_ATTR_VOLUME_ID	0x08
+#define FAT_ATTR_DIRECTORY	0x10
+#define FAT_ATTR_LONG_NAME	0x0f
+#define FAT_ATTR_MASK		0x3f
+
+#define FAT_DIRENT_SIZE		32
+#define FAT_DIRENT_FREE		0xe5
+#define FAT_DIRENT_END		0x00
+#define FAT_LFN_LAST		0x40
+#define FAT_LFN_CHARS		13
+#define FAT_LFN_ENTRIES_MAX	20
+#define FAT_NAME_MAX		(FAT_LFN_CHARS * FAT_LFN_ENTRIES_MAX)
+
+/* Contiguous bytes on disk that a file or directory occupies */
+typedef struct {
+	uint64_t offset;
+	uint64_t length;
+} Fat_Run;
+
+typedef struct {
+	Efi_Disk_Io_Protocol *diskIo;
+	uint32_t mediaId;
+
+	int type;
+	uint32_t clusterSize;
+	uint32_t clusterNum;
+	uint32_t clusterEnd;
+	uint32_t rootCluster;
+	uint64_t fatOffset, fatSize;
+	uint64_t rootOffset, rootSize;
+	uint64_t dataOffset;
+
+	uint8_t *fatCache;
+	int64_t fatCacheTag[FAT_CACHE_LINES];
+} Fat_Volume;
+
+typedef struct {
+	wchar_t name[FAT_NAME_MAX + 1];
+	uint8_t attr;
+	uint32_t cluster;
+	uint32_t size;
+	uint16_t date, time;
+} Fat_Dirent;
+
+typedef struct {
+	Efi_File_Protocol protocol;
+	Fat_Volume *vol;
+	int isRoot;
+	Fat_Dirent dirent;
+
+	uint64_t size;
+	uint64_t position;
+	Fat_Run *runs;
+	size_t runNum;
+
+	/* Cached content, for directories only */
+	uint8_t *dirData;
+} Fat_File;
+
+static Fat_Volume gVolume;
+
+Efi_Status fat_file_open(Efi_File_Protocol *this,
+			 Efi_File_Protocol **newHandle,
+			 wchar_t *fileName, uint64_t openMode,
+			 uint64_t attributes);
+Efi_Status fat_file_close(Efi_File_Protocol *this);
+Efi_Status fat_file_read(Efi_File_Protocol *this, uint_native *bufSize,
+			 void *buf);
+Efi_Status fat_file_get_position(Efi_File_Protocol *this,
+				 uint64_t *position);
+Efi_Status fat_file_set_position(Efi_File_Protocol *this,
+				 uint64_t position);
+Efi_Status fat_file_get_info(Efi_File_Protocol *this, Efi_Guid *type,
+			     uint_native *bufSize, void *buf);
+
+static uint16_t
+le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t
+le32(const uint8_t *p)
+{
+	return le16(p) | ((uint32_t)le16(p + 2) << 16);
+}
+
+static int
+disk_read(Fat_Volume *vol, uint64_t offset, uint64_t size, void *buf)
+{
+	return efi_method(vol->diskIo, readDisk, vol->mediaId,
+			  offset, size, buf) != EFI_SUCCESS;
+}
+
+/*
+ * Read size bytes at offset from the first FAT. FAT is read and cached in
+ * lines of FAT_CACHE_LINE_SIZE bytes, thus walking a cluster chain only
+ * touches the disk when it steps into another line.
+ */
+static int
+fat_read(Fat_Volume *vol, uint64_t offset, uint8_t *buf, size_t size)
+{
+	for (; size; size--, offset++) {
+		uint64_t line = offset / FAT_CACHE_LINE_SIZE;
+		uint64_t lineOffset = line * FAT_CACHE_LINE_SIZE;
+		size_t slot = line % FAT_CACHE_LINES;
+		uint8_t *cache = vol->fatCache + slot * FAT_CACHE_LINE_SIZE;
+
+		if (offset >= vol->fatSize)
+			return -1;
+
+		if (vol->fatCacheTag[slot] != (int64_t)line) {
+			uint64_t lineSize = vol->fatSize - lineOffset;
+			if (lineSize > FAT_CACHE_LINE_SIZE)
+				lineSize = FAT_CACHE_LINE_SIZE;
+
+			vol->fatCacheTag[slot] = -1;
+			if (disk_read(vol, vol->fatOffset + lineOffset,
+				      lineSize, cache))
+				return -1;
+			vol->fatCacheTag[slot] = line;
+		}
+
+		*(buf++) = cache[offset - lineOffset];
+	}
+
+	return 0;
+}
+
+static int
+fat_next_cluster(Fat_Volume *vol, uint32_t cluster, uint32_t *next)
+{
+	uint8_t entry[4];
+
+	switch (vol->type) {
+	case 12:
+		if (fat_read(vol, cluster + cluster / 2, entry, 2))
+			return -1;
+		*next = cluster & 1 ? le16(entry) >> 4 : le16(entry) & 0xfff;
+		break;
+	case 16:
+		if (fat_read(vol, cluster * 2, entry, 2))
+			return -1;
+		*next = le16(entry);
+		break;
+	default:
+		if (fat_read(vol, cluster * 4, entry, 4))
+			return -1;
+		*next = le32(entry) & 0x0fffffff;
+		break;
+	}
+
+	return 0;
+}
+
+/*
+ * Walk the cluster chain starting from cluster once, and merge contiguous
+ * clusters into runs, which are later read with a single request each.
+ */
+static int
+fat_build_runs(Fat_Volume *vol, uint32_t cluster, Fat_Run **runs,
+	       size_t *runNum)
+{
+	Fat_Run *r = NULL;
+	size_t num = 0;
+	uint32_t visited = 0;
+
+	while (1) {
+		/* Bad clusters or loops in the chain */
+		if (cluster < 2 || cluster > vol->clusterNum + 1 ||
+		    visited++ > vol->clusterNum)
+			goto err;
+
+		uint64_t offset = vol->dataOffset +
+				  (uint64_t)(cluster - 2) * vol->clusterSize;
+
+		if (num && r[num - 1].offset + r[num - 1].length == offset) {
+			r[num - 1].length += vol->clusterSize;
+		} else {
+			r = realloc_grow(r, (num + 1) * sizeof(*r));
+			r[num++] = (Fat_Run) { offset, vol->clusterSize };
+		}
+
+		if (fat_next_cluster(vol, cluster, &cluster))
+			goto err;
+
+		if (cluster >= vol->clusterEnd)
+			break;
+	}
+
+	*runs	= r;
+	*runNum	= num;
+	return 0;
+
+err:
+	free(r);
+	return -1;
+}
+
+static int
+fat_read_runs(Fat_File *f, uint64_t pos, void *buf, uint64_t size)
+{
+	uint8_t *p = buf;
+
+	for (size_t i = 0; i < f->runNum && size; i++) {
+		Fat_Run *run = &f->runs[i];
+
+		if (pos >= run->length) {
+			pos -= run->length;
+			continue;
+		}
+
+		uint64_t n = run->length - pos;
+		if (n > size)
+			n = size;
+
+		if (disk_read(f->vol, run->offset + pos, n, p))
+			return -1;
+
+		p	+= n;
+		size	-= n;
+		pos	= 0;
+	}
+
+	return size ? -1 : 0;
+}
+
+static void
+fat_file_free(Fat_File *f)
+{
+	free(f->runs);
+	free(f->dirData);
+	free(f);
+}
+
+/*
+ * Create a file object for dirent, or for the root directory if dirent is
+ * NULL or refers to cluster 0 as ".." entries do.
+ */
+static Fat_File *
+fat_file_new(Fat_Volume *vol, const Fat_Dirent *dirent)
+{
+	Fat_File *f = malloc(sizeof(*f));
+
+	*f = (Fat_File) {
+		.protocol	= {
+			.revision	= EFI_FILE_PROTOCOL_REVISION,
+			.open		= fat_file_open,
+			.close		= fat_file_close,
+			.read		= fat_file_read,
+			.getPosition	= fat_file_get_position,
+			.setPosition	= fat_file_set_position,
+			.getInfo	= fat_file_get_info,
+		},
+		.vol		= vol,
+	};
+
+	if (!dirent ||
+	    (dirent->attr & FAT_ATTR_DIRECTORY && !dirent->cluster)) {
+		f->isRoot		= 1;
+		f->dirent.attr		= FAT_ATTR_DIRECTORY;
+
+		if (vol->type == 32) {
+			f->dirent.cluster = vol->rootCluster;
+		} else {
+			f->runs		= malloc(sizeof(*f->runs));
+			f->runs[0]	= (Fat_Run) {
+				vol->rootOffset, vol->rootSize,
+			};
+			f->runNum	= 1;
+		}
+	} else {
+		f->dirent = *dirent;
+	}
+
+	if (f->dirent.cluster &&
+	    fat_build_runs(vol, f->dirent.cluster, &f->runs, &f->runNum))
+		goto err;
+
+	uint64_t allocated = 0;
+	for (size_t i = 0; i < f->runNum; i++)
+		allocated += f->runs[i].length;
+
+	if (f->dirent.attr & FAT_ATTR_DIRECTORY) {
+		f->size = allocated;
+	} else {
+		f->size = f->dirent.size;
+		if (f->size > allocated)
+			goto err;
+	}
+
+	return f;
+
+err:
+	fat_file_free(f);
+	return NULL;
+}
+
+static int
+fat_load_dir(Fat_File *dir)
+{
+	if (dir->dirData)
+		return 0;
+
+	if (!dir->size)
+		return -1;
+
+	dir->dirData = malloc(dir->size);
+	if (fat_read_runs(dir, 0, dir->dirData, dir->size)) {
+		free(dir->dirData);
+		dir->dirData = NULL;
+		return -1;
+	}
+
+	return 0;
+}
+
+static uint8_t
+fat_short_name_checksum(const uint8_t *name)
+{
+	uint8_t sum = 0;
+
+	for (int i = 0; i < 11; i++)
+		sum = ((sum & 1) << 7) + (sum >> 1) + name[i];
+
+	return sum;
+}
+
+static void
+fat_short_name(const uint8_t *e, wchar_t *name)
+{
+	int lowerBase = e[12] & 0x08, lowerExt = e[12] & 0x10;
+	int len = 0;
+
+	for (int i = 0; i < 8 && e[i] != ' '; i++) {
+		/* 0x05 stands for 0xe5 as the first character */
+		int c = !i && e[i] == 0x05 ? 0xe5 : e[i];
+		name[len++] = lowerBase ? tolower(c) : c;
+	}
+
+	if (e[8] != ' ') {
+		name[len++] = '.';
+		for (int i = 8; i < 11 && e[i] != ' '; i++)
+			name[len++] = lowerExt ? tolower(e[i]) : e[i];
+	}
+
+	name[len] = 0;
+}
+
+static void
+fat_lfn_copy(const uint8_t *e, wchar_t *name)
+{
+	static const uint8_t offsets[FAT_LFN_CHARS] = {
+		1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30,
+	};
+
+	for (int i = 0; i < FAT_LFN_CHARS; i++)
+		name[i] = le16(e + offsets[i]);
+}
+
+/*
+ * Retrieve the next entry of a loaded directory, starting from byte offset
+ * *pos, which is then updated to point after the entry.
+ *
+ * Return 0 if an entry is found, or -1 at the end of directory.
+ */
+static int
+fat_dir_next(Fat_File *dir, uint64_t *pos, Fat_Dirent *dirent)
+{
+	int lfnValid = 0, lfnSeq = 0;
+	uint8_t lfnChecksum = 0;
+
+	for (; *pos + FAT_DIRENT_SIZE <= dir->size; *pos += FAT_DIRENT_SIZE) {
+		const uint8_t *e = dir->dirData + *pos;
+		uint8_t attr = e[11];
+
+		if (e[0] == FAT_DIRENT_END) {
+			*pos = dir->size;
+			break;
+		}
+
+		if (e[0] == FAT_DIRENT_FREE) {
+			lfnValid = 0;
+			continue;
+		}
+
+		/*
+		 * Long file names are stored in reverse order before the short
+		 * entry, each piece holding 13 UCS-2 characters.
+		 */
+		if ((attr & FAT_ATTR_MASK) == FAT_ATTR_LONG_NAME) {
+			int seq = e[0] & 0x1f;
+
+			if (e[0] & FAT_LFN_LAST) {
+				lfnValid = seq && seq <= FAT_LFN_ENTRIES_MAX;
+				lfnChecksum = e[13];
+				if (lfnValid)
+					dirent->name[seq * FAT_LFN_CHARS] = 0;
+			} else {
+				lfnValid = lfnValid && seq == lfnSeq - 1 &&
+					   e[13] == lfnChecksum;
+			}
+
+			lfnSeq = seq;
+			if (lfnValid)
+				fat_lfn_copy(e, dirent->name +
+						(seq - 1) * FAT_LFN_CHARS);
+			continue;
+		}
+
+		if (attr & FAT_ATTR_VOLUME_ID) {
+			lfnValid = 0;
+			continue;
+		}
+
+		if (!lfnValid || lfnSeq != 1 ||
+		    fat_short_name_checksum(e) != lfnChecksum)
+			fat_short_name(e, dirent->name);
+
+		dirent->attr	= attr;
+		dirent->cluster	= le16(e + 26);
+		if (dir->vol->type == 32)
+			dirent->cluster |= (uint32_t)le16(e + 20) << 16;
+		dirent->size	= le32(e + 28);
+		dirent->time	= le16(e + 22);
+		dirent->date	= le16(e + 24);
+
+		*pos += FAT_DIRENT_SIZE;
+		return 0;
+	}
+
+	return -1;
+}
+
+static int
+fat_name_equal(const wchar_t *name, const wchar_t *s, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (!name[i] || toupper(name[i]) != toupper(s[i]))
+			return 0;
+	}
+
+	return !name[len];
+}
+
+static int
+fat_lookup(Fat_File *dir, const wchar_t *name, size_t len, Fat_Dirent *dirent)
+{
+	if (!(dir->dirent.attr & FAT_ATTR_DIRECTORY) || fat_load_dir(dir))
+		return 0;
+
+	uint64_t pos = 0;
+	while (!fat_dir_next(dir, &pos, dirent)) {
+		if (fat_name_equal(dirent->name, name, len))
+			return 1;
+	}
+
+	return 0;
+}
+
+static size_t
+fat_fill_info(Fat_Volume *vol, const Fat_Dirent *dirent, uint64_t fileSize,
+	      Efi_File_Info *info)
+{
+	size_t size = sizeof(*info) +
+		      (wcslen(dirent->name) + 1) * sizeof(wchar_t);
+
+	if (!info)
+		return size;
+
+	memset(info, 0, sizeof(*info));
+	info->size		= size;
+	info->fileSize		= fileSize;
+	info->physicalSize	= (fileSize + vol->clusterSize - 1) /
+				  vol->clusterSize * vol->clusterSize;
+	info->attribute		= dirent->attr & EFI_FILE_VALID_ATTR;
+
+	if (dirent->date) {
+		info->modificationTime = (Efi_Time) {
+			.Year	= 1980 + (dirent->date >> 9),
+			.Month	= (dirent->date >> 5) & 0xf,
+			.Day	= dirent->date & 0x1f,
+			.Hour	= dirent->time >> 11,
+			.Minute	= (dirent->time >> 5) & 0x3f,
+			.Second	= (dirent->time & 0x1f) * 2,
+		};
+	}
+
+	wcscpy(info->fileName, dirent->name);
+
+	return size;
+}
+
+Efi_Status
+efi_callback(fat_file_open)(Efi_File_Protocol *this,
+			  Efi_File_Protocol **newHandle,
+			  wchar_t *fileName, uint64_t openMode,
+			  uint64_t attributes)
+{
+	Fat_File *cur = (Fat_File *)this;
+	(void)attributes;
+
+	if (!newHandle || !fileName)
+		return TO_EFI_ERRNO(EFI_INVALID_PARAMETER);
+
+	if (openMode != EFI_FILE_MODE_READ)
+		return TO_EFI_ERRNO(EFI_WRITE_PROTECTED);
+
+	const wchar_t *p = fileName;
+	Fat_File *f = fat_file_new(cur->vol, *p == '\\' || cur->isRoot ?
+					     NULL : &cur->dirent);
+
+	while (f && *p) {
+		while (*p == '\\')
+			p++;
+
+		const wchar_t *end = p;
+		while (*end && *end != '\\')
+			end++;
+
+		size_t len = end - p;
+		if (!len || (len == 1 && p[0] == '.')) {
+			p = end;
+			continue;
+		}
+
+		Fat_Dirent dirent;
+		int found = fat_lookup(f, p, len, &dirent);
+
+		fat_file_free(f);
+		f = found ? fat_file_new(cur->vol, &dirent) : NULL;
+		p = end;
+	}
+
+	if (!f)
+		return TO_EFI_ERRNO(EFI_NOT_FOUND);
+
+	*newHandle = &f->protocol;
+	return EFI_SUCCESS;
+}
+
+Efi_Status
+efi_callback(fat_file_close)(Efi_File_Protocol *this)
+{
+	fat_file_free((Fat_File *)this);
+	return EFI_SUCCESS;
+}
+
+/*
+ * Reading a directory returns an Efi_File_Info for the next entry on each
+ * call, and a zero size at the end.
+ */
+static Efi_Status
+fat_dir_read(Fat_File *dir, uint_native *bufSize, void *buf)
+{
+	if (fat_load_dir(dir))
+		return TO_EFI_ERRNO(EFI_DEVICE_ERROR);
+
+	uint64_t pos = dir->position;
+	Fat_Dirent dirent;
+
+	if (fat_dir_next(dir, &pos, &dirent)) {
+		dir->position	= pos;
+		*bufSize	= 0;
+		return EFI_SUCCESS;
+	}
+
+	uint64_t fileSize = dirent.attr & FAT_ATTR_DIRECTORY ? 0 : dirent.size;
+	size_t infoSize = fat_fill_info(dir->vol, &dirent, fileSize, NULL);
+	if (*bufSize < infoSize) {
+		*bufSize = infoSize;
+		return TO_EFI_ERRNO(EFI_BUFFER_TOO_SMALL);
+	}
+
+	fat_fill_info(dir->vol, &dirent, fileSize, buf);
+	*bufSize	= infoSize;
+	dir->position	= pos;
+
+	return EFI_SUCCESS;
+}
+
+Efi_Status
+efi_callback(fat_file_read)(Efi_File_Protocol *this, uint_native *bufSize,
+			  void *buf)
+{
+	Fat_File *f = (Fat_File *)this;
+
+	if (f->dirent.attr & FAT_ATTR_DIRECTORY)
+		return fat_dir_read(f, bufSize, buf);
+
+	uint64_t remaining = f->position < f->size ? f->size - f->position : 0;
+	uint64_t size = *bufSize < remaining ? *bufSize : remaining;
+
+	if (size && fat_read_runs(f, f->position, buf, size))
+		return TO_EFI_ERRNO(EFI_DEVICE_ERROR);
+
+	f->position	+= size;
+	*bufSize	= size;
+
+	return EFI_SUCCESS;
+}
+
+Efi_Status
+efi_callback(fat_file_get_position)(Efi_File_Protocol *this,
+				    uint64_t *position)
+{
+	Fat_File *f = (Fat_File *)this;
+
+	if (f->dirent.attr & FAT_ATTR_DIRECTORY)
+		return TO_EFI_ERRNO(EFI_UNSUPPORTED);
+
+	*position = f->position;
+	return EFI_SUCCESS;
+}
+
+/*
+ * Directories could only be rewound to their first entry. Positions beyond
+ * the end of a file are allowed, and 0xffffffffffffffff means the end.
+ */
+Efi_Status
+efi_callback(fat_file_set_position)(Efi_File_Protocol *this,
+				    uint64_t position)
+{
+	Fat_File *f = (Fat_File *)this;
+
+	if (f->dirent.attr & FAT_ATTR_DIRECTORY) {
+		if (position)
+			return TO_EFI_ERRNO(EFI_UNSUPPORTED);
+	} else if (position == ~(uint64_t)0) {
+		position = f->size;
+	}
+
+	f->position = position;
+	return EFI_SUCCESS;
+}
+
+Efi_Status
+efi_callback(fat_file_get_info)(Efi_File_Protocol *this, Efi_Guid *type,
+			      uint_native *bufSize, void *buf)
+{
+	Fat_File *f = (Fat_File *)this;
+	Efi_Guid fileInfoGuid = EFI_FILE_INFO_GUID;
+
+	if (memcmp(type, &fileInfoGuid, sizeof(fileInfoGuid)))
+		return TO_EFI_ERRNO(EFI_UNSUPPORTED);
+
+	size_t infoSize = fat_fill_info(f->vol, &f->dirent, f->size, NULL);
+	if (*bufSize < infoSize) {
+		*bufSize = infoSize;
+		return TO_EFI_ERRNO(EFI_BUFFER_TOO_SMALL);
+	}
+
+	fat_fill_info(f->vol, &f->dirent, f->size, buf);
+	*bufSize = infoSize;
+
+	return EFI_SUCCESS;
+}
+
+static int
+fat_parse_bpb(Fat_Volume *vol, const uint8_t *bs)
+{
+	uint32_t sectorSize	= le16(bs + 11);
+	uint32_t clusterSectors	= bs[13];
+	uint32_t reserved	= le16(bs + 14);
+	uint32_t fatNum		= bs[16];
+	uint32_t rootEntries	= le16(bs + 17);
+	uint32_t totalSectors	= le16(bs + 19) ? le16(bs + 19) : le32(bs + 32);
+	uint32_t fatSectors	= le16(bs + 22) ? le16(bs + 22) : le32(bs + 36);
+
+	if ((bs[0] != 0xeb && bs[0] != 0xe9) || le16(bs + 510) != 0xaa55)
+		return -1;
+
+	if (sectorSize < 512 || sectorSize > 4096 ||
+	    (sectorSize & (sectorSize - 1)))
+		return -1;
+
+	if (!clusterSectors || (clusterSectors & (clusterSectors - 1)))
+		return -1;
+
+	if (!reserved || !fatNum || !fatSectors || !totalSectors)
+		return -1;
+
+	uint32_t rootSectors = (rootEntries * FAT_DIRENT_SIZE +
+				sectorSize - 1) / sectorSize;
+	uint64_t dataStart = reserved + (uint64_t)fatNum * fatSectors +
+			     rootSectors;
+	if (dataStart >= totalSectors)
+		return -1;
+
+	vol->clusterNum	= (totalSectors - dataStart) / clusterSectors;
+	vol->type	= vol->clusterNum < 4085  ? 12 :
+			  vol->clusterNum < 65525 ? 16 : 32;
+	vol->clusterEnd	= vol->type == 12 ? 0xff8 :
+			  vol->type == 16 ? 0xfff8 : 0x0ffffff8;
+
+	/* Only FAT12/16 have a fixed root directory region */
+	if ((vol->type == 32) != !rootEntries)
+		return -1;
+
+	vol->clusterSize	= sectorSize * clusterSectors;
+	vol->fatOffset		= (uint64_t)reserved * sectorSize;
+	vol->fatSize		= (uint64_t)fatSectors * sectorSize;
+	vol->rootOffset		= vol->fatOffset + fatNum * vol->fatSize;
+	vol->rootSize		= (uint64_t)rootEntries * FAT_DIRENT_SIZE;
+	vol->rootCluster	= le32(bs + 44);
+	vol->dataOffset		= dataStart * sectorSize;
+
+	/* FAT must be large enough to describe every cluster */
+	if ((uint64_t)(vol->clusterNum + 2) * vol->type / 8 > vol->fatSize)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * Try to mount the FAT filesystem on device with the built-in driver. Note
+ * this is called before the console is set up, thus nothing is printed.
+ *
+ * Return 0 and store handle of the root directory in root on success,
+ * otherwise -1, in which case the caller should fall back to the firmware
+ * driver.
+ */
+int
+fat_open_volume(Efi_Handle device, Efi_File_Protocol **root)
+{
+	Efi_Block_Io_Protocol *blockIo = NULL;
+	Efi_Disk_Io_Protocol *diskIo = NULL;
+	Fat_Volume *vol = &gVolume;
+
+	efi_handle_protocol(device, EFI_BLOCK_IO_PROTOCOL_GUID, &blockIo);
+	efi_handle_protocol(device, EFI_DISK_IO_PROTOCOL_GUID, &diskIo);
+	if (!blockIo || !diskIo || !blockIo->media->mediaPresent)
+		return -1;
+
+	vol->diskIo	= diskIo;
+	vol->mediaId	= blockIo->media->mediaId;
+
+	uint8_t bootSector[512];
+	if (disk_read(vol, 0, sizeof(bootSector), bootSector) ||
+	    fat_parse_bpb(vol, bootSector))
+		return -1;
+
+	vol->fatCache = malloc(FAT_CACHE_LINE_SIZE * FAT_CACHE_LINES);
+	for (int i = 0; i < FAT_CACHE_LINES; i++)
+		vol->fatCacheTag[i] = -1;
+
+	Fat_File *f = fat_file_new(vol, NULL);
+	if (!f) {
+		free(vol->fatCache);
+		return -1;
+	}
+
+	*root = &f->protocol;
+	return 0;
+}
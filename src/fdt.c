@@ -24,7 +24,42 @@ be32_to_cpu(uint32_t val)
 	return (data[0] << 24) | (data[1] << 16) | (data[2] << 8) | data[3];
 }
 
-void
+/*
+ * Check the FDT header, and that the blob fits in a file of fileSize bytes.
+ *
+ * Return 0 if the header is valid, otherwise print the reason and return -1.
+ */
+int
+fdt_check_header(const Fdt_Header *fdt, uint64_t fileSize)
+{
+	uint32_t totalSize = be32_to_cpu(fdt->totalSize);
+
+	if (be32_to_cpu(fdt->magic) != FDT_MAGIC) {
+		pr_err("devicetree: bad magic 0x%x\n", be32_to_cpu(fdt->magic));
+		return -1;
+	}
+
+	if (totalSize < sizeof(Fdt_Header) || totalSize > fileSize) {
+		pr_err("devicetree: invalid size %u, file size %lu\n",
+		       totalSize, fileSize);
+		return -1;
+	}
+
+	if (be32_to_cpu(fdt->lastCompVersion) > FDT_LAST_COMP_VERSION) {
+		pr_err("devicetree: incompatible version %u\n",
+		       be32_to_cpu(fdt->lastCompVersion));
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Install a fixed-up copy of fdt as the devicetree configuration table.
+ *
+ * Return the copy, which stays referred by the table until it's replaced.
+ */
+Fdt_Header *
 fdt_fixup_and_load(Fdt_Header *fdt)
 {
 	/* TODO: check compatibility */
@@ -54,4 +89,6 @@ fdt_fixup_and_load(Fdt_Header *fdt)
 	}
 
 	efi_install_configuration_table(EFI_DTB_TABLE_GUID, copy);
+
+	return copy;
 }
@@ -11,12 +11,41 @@
 #include <efiboot.h>
 #include <efiloadedimage.h>
 #include <efimedia.h>
+#include <ctype.h>
 #include <memory.h>
 #include <string.h>
 
+#include <ext4.h>
+#include <fat.h>
+#include <file.h>
 #include <misc.h>
+#include <timer.h>
 
-static Efi_File_Protocol *root;
+#define FILE_ROOTS_MAX	8
+
+/* The ESP always comes first */
+static Efi_File_Protocol *roots[FILE_ROOTS_MAX];
+static int rootNum;
+
+#define FILE_CACHE_SIZE	16
+
+typedef struct {
+	wchar_t *path;
+	Efi_File_Protocol *file;
+	Efi_File_Info *info;
+	int inUse;
+} File_Cache_Entry;
+
+/* Opened files, kept until loli exits */
+static File_Cache_Entry fileCache[FILE_CACHE_SIZE];
+
+#define FILE_STATS_MAX	32
+
+static File_Stats fileStats[FILE_STATS_MAX];
+static uint32_t fileStatsNum;
+
+/* Listings of directories, kept until loli exits */
+static File_Dir *dirCache;
 
 void
 file_init(void)
@@ -24,11 +53,27 @@ file_init(void)
 	Efi_Loaded_Image_Protocol *img;
 	efi_handle_protocol(gSelf, EFI_LOADED_IMAGE_PROTOCOL_GUID, &img);
 
-	Efi_Simple_File_System_Protocol *fs;
-	efi_handle_protocol(img->deviceHandle,
-			    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_GUID, &fs);
+	Efi_File_Protocol *esp = NULL;
+
+#ifdef LOLI_NATIVE_FAT
+	if (fat_open_volume(img->deviceHandle, &esp))
+		esp = NULL;
+#endif
 
-	efi_method(fs, openVolume, &root);
+	if (!esp) {
+		Efi_Simple_File_System_Protocol *fs;
+		efi_handle_protocol(img->deviceHandle,
+				    EFI_SIMPLE_FILE_SYSTEM_PROTOCOL_GUID, &fs);
+
+		efi_method(fs, openVolume, &esp);
+	}
+
+	roots[rootNum++] = esp;
+
+#ifdef LOLI_EXT4
+	rootNum += ext4_open_volumes(roots + rootNum,
+				     FILE_ROOTS_MAX - rootNum);
+#endif
 }
 
 
@@ -50,35 +95,98 @@ fix_path(wchar_t *path)
 	*cur = 0;
 }
 
-Efi_File_Protocol *
-file_open(const wchar_t *path)
+/*
+ * Find the statistics record of path, or create one if there's room left.
+ * Paths beyond FILE_STATS_MAX aren't accounted, and NULL is returned. So are
+ * paths too long for File_Stats, instead of being merged with others sharing
+ * the same prefix.
+ *
+ * path is converted from a char string by str2wcs(), thus wcs2str() gives the
+ * original bytes back.
+ */
+static File_Stats *
+file_stats_get(const wchar_t *path)
+{
+	char name[FILE_STATS_PATH_MAX];
+	size_t i;
+
+	if (wcs2str(NULL, path) >= FILE_STATS_PATH_MAX)
+		return NULL;
+
+	wcs2str(name, path);
+
+	for (i = 0; i < fileStatsNum; i++) {
+		if (!strcmp(fileStats[i].path, name))
+			return &fileStats[i];
+	}
+
+	if (fileStatsNum == FILE_STATS_MAX)
+		return NULL;
+
+	File_Stats *stats = &fileStats[fileStatsNum++];
+	strcpy(stats->path, name);
+
+	return stats;
+}
+
+static Efi_File_Protocol *
+file_open_fixed(const wchar_t *fixedPath, File_Stats *stats)
 {
 	Efi_File_Protocol *file = NULL;
+	uint64_t start = timer_read();
 	Efi_Status ret;
 
-	wchar_t *fixedPath = malloc((wcslen(path) + 1) * sizeof(wchar_t));
+	/* Look the file up in the ESP first, then in other volumes */
+	for (int i = 0; i < rootNum && !file; i++) {
+		ret = efi_method(roots[i], open, &file,
+				 (wchar_t *)fixedPath, EFI_FILE_MODE_READ, 0);
+		if (ret != EFI_SUCCESS)
+			file = NULL;
+
+		if (stats)
+			stats->opens++;
+	}
+
+	if (stats)
+		stats->lookupTicks += timer_read() - start;
+
+	return file;
+}
+
+Efi_File_Protocol *
+file_open(const wchar_t *path)
+{
+	Arena_Mark mark = arena_mark();
+	wchar_t *fixedPath = arena_alloc((wcslen(path) + 1) * sizeof(wchar_t));
 	wcscpy(fixedPath, path);
 	fix_path(fixedPath);
 
-	ret = efi_method(root, open, &file,
-			 (wchar_t *)fixedPath, EFI_FILE_MODE_READ, 0);
-	if (ret != EFI_SUCCESS)
-		file = NULL;
+	Efi_File_Protocol *file = file_open_fixed(fixedPath, NULL);
 
-	free(fixedPath);
+	arena_reset(mark);
 	return file;
 }
 
-static Efi_File_Protocol *
-file_open_str(const char *path)
+/*
+ * Convert path to UTF-16 and normalize it, the result is allocated from the
+ * arena.
+ */
+static wchar_t *
+file_fix_str_path(const char *path)
 {
-	wchar_t *wpath = malloc((str2wcs(NULL, path) + 1) * sizeof(wchar_t));
+	wchar_t *wpath = arena_alloc((str2wcs(NULL, path) + 1) *
+				     sizeof(wchar_t));
 	str2wcs(wpath, path);
+	fix_path(wpath);
 
-	Efi_File_Protocol *file = file_open(wpath);
-	free(wpath);
+	return wpath;
+}
 
-	return file;
+static wchar_t *
+file_dup_path(const wchar_t *path)
+{
+	wchar_t *copy = malloc((wcslen(path) + 1) * sizeof(wchar_t));
+	return wcscpy(copy, path);
 }
 
 Efi_Status
@@ -107,49 +215,736 @@ file_get_info(Efi_File_Protocol *file, Efi_File_Info **info)
 	return ret;
 }
 
+static void
+file_cache_evict(File_Cache_Entry *e)
+{
+	efi_call(e->file->close, e->file);
+	free(e->path);
+	free(e->info);
+	*e = (File_Cache_Entry) { 0 };
+}
+
+/*
+ * Handles returned by file_open_cached() go back to the cache, and are only
+ * closed by file_fini().
+ */
 void
 file_close(Efi_File_Protocol *file)
 {
+	for (int i = 0; i < FILE_CACHE_SIZE; i++) {
+		if (fileCache[i].file == file) {
+			fileCache[i].inUse = 0;
+			return;
+		}
+	}
+
 	efi_call(file->close, file);
 }
 
+/*
+ * Close every cached handle and drop directory listings, called right before
+ * loli exits.
+ */
+void
+file_fini(void)
+{
+	for (int i = 0; i < FILE_CACHE_SIZE; i++) {
+		if (fileCache[i].file)
+			file_cache_evict(&fileCache[i]);
+	}
+
+	while (dirCache) {
+		File_Dir *next = dirCache->next;
+
+		free(dirCache->entries);
+		free(dirCache->names);
+		free(dirCache->path);
+		free(dirCache);
+
+		dirCache = next;
+	}
+}
+
+/*
+ * Print I/O statistics of every file looked up, and install them as a
+ * configuration table for later stages.
+ */
+void
+file_stats_report(void)
+{
+	pr_info("I/O statistics (time in us):\n");
+	pr_info("opens getinfos reads hits bytes lookup read path\n");
+
+	for (uint32_t i = 0; i < fileStatsNum; i++) {
+		File_Stats *stats = &fileStats[i];
+		pr_info("%lu %lu %lu %lu %lu %lu %lu %s\n",
+			stats->opens, stats->getInfos, stats->reads,
+			stats->cacheHits, stats->bytes,
+			timer_to_us(stats->lookupTicks),
+			timer_to_us(stats->readTicks), stats->path);
+	}
+
+	size_t size = sizeof(File_Stats_Table) +
+		      fileStatsNum * sizeof(File_Stats);
+	File_Stats_Table *table = malloc(size);
+
+	table->version		= FILE_STATS_VERSION;
+	table->fileNum		= fileStatsNum;
+	table->timerFrequency	= timer_frequency();
+	memcpy(table->files, fileStats, fileStatsNum * sizeof(File_Stats));
+
+	efi_install_configuration_table(LOLI_FILE_STATS_TABLE_GUID, table);
+}
+
+/*
+ * Open a file by its ASCII path through the cache, which keeps the handle and
+ * information of files opened before, keyed by their normalized UTF-16 path.
+ * Looking up a cached file again only costs a setPosition() call to rewind
+ * the handle. A cached handle is handed out to one user at a time, others get
+ * a fresh one.
+ *
+ * Return the opened file and store its information in info, or NULL if the
+ * file cannot be opened. cached is set if info is owned by the cache,
+ * otherwise the caller should free it.
+ */
+static Efi_File_Protocol *
+file_open_cached(const char *path, Efi_File_Info **info, int *cached,
+		 File_Stats **statsp)
+{
+	Arena_Mark mark = arena_mark();
+	wchar_t *wpath = file_fix_str_path(path);
+
+	File_Stats *stats = file_stats_get(wpath);
+	*statsp = stats;
+
+	File_Cache_Entry *slot = NULL;
+	for (int i = 0; i < FILE_CACHE_SIZE; i++) {
+		File_Cache_Entry *e = &fileCache[i];
+
+		if (!e->file || e->inUse || wcscmp(e->path, wpath)) {
+			if (!slot && !e->file)
+				slot = e;
+			continue;
+		}
+
+		if (efi_method(e->file, setPosition, 0) == EFI_SUCCESS) {
+			arena_reset(mark);
+			if (stats)
+				stats->cacheHits++;
+			e->inUse	= 1;
+			*info		= e->info;
+			*cached		= 1;
+			return e->file;
+		}
+
+		/* The handle is stale, reopen the file into its slot */
+		file_cache_evict(e);
+		slot = e;
+	}
+
+	Efi_File_Protocol *file = file_open_fixed(wpath, stats);
+	if (!file)
+		goto out;
+
+	uint64_t start = timer_read();
+	Efi_Status ret = file_get_info(file, info);
+	if (stats) {
+		stats->getInfos++;
+		stats->lookupTicks += timer_read() - start;
+	}
+
+	if (ret != EFI_SUCCESS) {
+		efi_call(file->close, file);
+		file = NULL;
+		goto out;
+	}
+
+	/* Evict an idle entry when the cache is full */
+	for (int i = 0; i < FILE_CACHE_SIZE && !slot; i++) {
+		if (!fileCache[i].inUse) {
+			slot = &fileCache[i];
+			file_cache_evict(slot);
+		}
+	}
+
+	*cached = slot != NULL;
+	if (slot) {
+		*slot = (File_Cache_Entry) {
+			.path	= file_dup_path(wpath),
+			.file	= file,
+			.info	= *info,
+			.inUse	= 1,
+		};
+	}
+
+out:
+	arena_reset(mark);
+	return file;
+}
+
+/*
+ * Open a regular file by its ASCII path, the size of file is stored in size.
+ *
+ * Return the opened file if it exists and isn't a directory, otherwise NULL.
+ */
+static Efi_File_Protocol *
+file_open_regular(const char *path, uint64_t *size, File_Stats **stats)
+{
+	Efi_File_Info *info;
+	int cached;
+	Efi_File_Protocol *file = file_open_cached(path, &info, &cached, stats);
+	if (!file)
+		return NULL;
+
+	int isDir = info->attribute & EFI_FILE_DIRECTORY;
+	*size = info->fileSize;
+
+	if (!cached)
+		free(info);
+
+	if (isDir) {
+		file_close(file);
+		return NULL;
+	}
+
+	return file;
+}
+
 int64_t
 file_get_size(const char *path)
 {
-	Efi_File_Protocol *file = file_open_str(path);
-	Efi_File_Info *info;
+	uint64_t fileSize;
+	File_Stats *stats;
+	Efi_File_Protocol *file = file_open_regular(path, &fileSize, &stats);
 
 	if (!file)
 		return -1;
 
-	if (file_get_info(file, &info) != EFI_SUCCESS)
-		return -1;
-
-	uint64_t fileSize = info->fileSize;
-	free(info);
 	file_close(file);
 	return (int64_t)fileSize;
 }
 
+/*
+ * Open a file for streaming. Every subsequent file_stream_read() reads at
+ * most chunkSize bytes, a zero chunkSize means reading all the remaining
+ * data at once.
+ *
+ * Return 0 on success, otherwise -1.
+ */
+int
+file_stream_open(File_Stream *s, const char *path, size_t chunkSize)
+{
+	s->file = file_open_regular(path, &s->size, &s->stats);
+	s->offset	= 0;
+	s->chunkSize	= chunkSize;
+
+	return s->file ? 0 : -1;
+}
+
+/*
+ * Read the next chunk of the stream into buf, which is bufSize bytes large.
+ *
+ * Return number of bytes read, 0 if the stream has reached its end, or -1 on
+ * failure.
+ */
 int64_t
-file_load(const char *path, void **buf)
+file_stream_read(File_Stream *s, void *buf, size_t bufSize)
 {
-	Efi_File_Protocol *file = file_open_str(path);
-	if (!file)
+	uint64_t remaining = s->size - s->offset;
+	uint_native readSize = remaining < bufSize ? remaining : bufSize;
+
+	if (s->chunkSize && readSize > s->chunkSize)
+		readSize = s->chunkSize;
+
+	if (!readSize)
+		return 0;
+
+	uint64_t start = timer_read();
+	Efi_Status ret = efi_method(s->file, read, &readSize, buf);
+
+	if (s->stats) {
+		s->stats->reads++;
+		s->stats->readTicks += timer_read() - start;
+	}
+
+	if (ret != EFI_SUCCESS || !readSize)
 		return -1;
 
-	Efi_File_Info *info;
-	if (file_get_info(file, &info) != EFI_SUCCESS)
+	if (s->stats)
+		s->stats->bytes += readSize;
+
+	s->offset += readSize;
+	return (int64_t)readSize;
+}
+
+/*
+ * Move the stream to offset, which shouldn't go beyond the end of file.
+ *
+ * Return 0 on success, otherwise -1.
+ */
+int
+file_stream_seek(File_Stream *s, uint64_t offset)
+{
+	if (offset > s->size ||
+	    efi_method(s->file, setPosition, offset) != EFI_SUCCESS)
 		return -1;
 
-	if (info->attribute & EFI_FILE_DIRECTORY)
+	s->offset = offset;
+	return 0;
+}
+
+/*
+ * Read at most size bytes at offset of the file specified by path into buf,
+ * leaving the rest of file untouched.
+ *
+ * Return number of bytes read, which is smaller than size only if the file
+ * ends earlier, or -1 on failure.
+ */
+int64_t
+file_read_partial(const char *path, uint64_t offset, void *buf, size_t size)
+{
+	File_Stream s;
+	int64_t ret = -1;
+
+	if (file_stream_open(&s, path, 0))
 		return -1;
 
-	uint_native bufSize = info->fileSize;
-	free(info);
+	if (!file_stream_seek(&s, offset))
+		ret = file_stream_read(&s, buf, size);
+
+	file_stream_close(&s);
+	return ret;
+}
+
+/*
+ * Read the rest of the stream chunk by chunk, and feed each chunk to consumer
+ * as soon as it's read. consumer could be NULL, and a non-zero return value
+ * from it aborts the stream.
+ *
+ * If buf is large enough to hold the remaining data, chunks are placed at
+ * their offsets in buf one after another, leaving the whole file in buf at
+ * the end. Otherwise buf is reused as a window for every chunk, in which
+ * case consumer is the only one that sees the data.
+ *
+ * Return number of bytes consumed, or -1 on failure.
+ */
+int64_t
+file_stream_consume(File_Stream *s, void *buf, size_t bufSize,
+		    File_Chunk_Consumer consumer, void *ctx)
+{
+	uint64_t start = s->offset;
+	int window = bufSize < s->size - s->offset;
+
+	while (s->offset < s->size) {
+		uint64_t offset = s->offset;
+		uint8_t *p = window ? buf : (uint8_t *)buf + (offset - start);
+		size_t avail = window ? bufSize : bufSize - (offset - start);
+
+		int64_t n = file_stream_read(s, p, avail);
+		if (n <= 0)
+			return -1;
+
+		if (consumer && consumer(ctx, p, n, offset))
+			return -1;
+	}
+
+	return (int64_t)(s->offset - start);
+}
+
+void
+file_stream_close(File_Stream *s)
+{
+	if (s->file)
+		file_close(s->file);
+	s->file = NULL;
+}
+
+static void
+file_free_buffer(void *buf, File_Alloc_Type type, size_t size)
+{
+	if (type == FILE_ALLOC_PAGES)
+		free_pages(buf, size);
+	else
+		free(buf);
+}
+
+/*
+ * Load the whole file specified by path into a newly allocated buffer, with
+ * only one open and one getInfo call. The buffer is allocated from pool or as
+ * pages according to type, and is extra bytes larger than the file, which
+ * callers could make use of, for example, to terminate a text file.
+ *
+ * Return size of the file and store the buffer in buf on success, otherwise
+ * return -1. The buffer should be released with free() or
+ * free_pages(*buf, size + extra).
+ */
+int64_t
+file_load_alloc(const char *path, File_Alloc_Type type, size_t extra,
+		void **buf)
+{
+	File_Stream s;
+
+	*buf = NULL;
+	if (file_stream_open(&s, path, 0))
+		return -1;
+
+	size_t allocSize = s.size + extra;
+	void *p = type == FILE_ALLOC_PAGES ? malloc_pages(allocSize) :
+					     malloc(allocSize);
+	if (!p) {
+		pr_err("Unable to allocate %lu bytes for %s, "
+		       "insufficient memory?\n", allocSize, path);
+		goto close_stream;
+	}
+
+	if (file_stream_consume(&s, p, s.size, NULL, NULL) < 0) {
+		file_free_buffer(p, type, allocSize);
+		goto close_stream;
+	}
+
+	file_stream_close(&s);
+
+	*buf = p;
+	return (int64_t)s.size;
+
+close_stream:
+	file_stream_close(&s);
+	return -1;
+}
+
+static int
+file_read_async(File_Load_Request *req)
+{
+	Efi_File_Protocol *file = req->stream.file;
+	File_Stats *stats = req->stream.stats;
+
+	if (file->revision < EFI_FILE_PROTOCOL_REVISION2)
+		return -1;
+
+	req->token = (Efi_File_Io_Token) {
+		.bufferSize	= req->stream.size,
+		.buffer		= req->buf,
+	};
+
+	if (efi_call(gBS->createEvent, 0, 0, NULL, NULL,
+		     &req->token.event) != EFI_SUCCESS)
+		return -1;
+
+	/*
+	 * Some firmware claims revision 2 but doesn't really implement ReadEx,
+	 * let the caller fall back to synchronous read in this case.
+	 */
+	uint64_t start = timer_read();
+	Efi_Status ret = efi_method(file, readEx, &req->token);
+
+	if (stats) {
+		stats->reads++;
+		stats->readTicks += timer_read() - start;
+	}
+
+	if (ret != EFI_SUCCESS) {
+		efi_call(gBS->closeEvent, req->token.event);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int
+file_wait_async(File_Load_Request *req)
+{
+	File_Stats *stats = req->stream.stats;
+	uint64_t start = timer_read();
+	uint_native index;
+	Efi_Status ret = efi_call(gBS->waitForEvent, 1, &req->token.event,
+				  &index);
+
+	efi_call(gBS->closeEvent, req->token.event);
+
+	/* Reads in flight overlap, their readTicks may sum beyond wall time */
+	if (stats) {
+		stats->readTicks += timer_read() - start;
+		if (ret == EFI_SUCCESS && req->token.status == EFI_SUCCESS)
+			stats->bytes += req->token.bufferSize;
+	}
+
+	return ret != EFI_SUCCESS || req->token.status != EFI_SUCCESS ||
+	       req->token.bufferSize != req->stream.size ? -1 : 0;
+}
+
+/*
+ * Release the buffer of a request loaded by file_load_batch(), if any.
+ */
+void
+file_load_release(File_Load_Request *req)
+{
+	if (!req->buf)
+		return;
+
+	file_free_buffer(req->buf, req->type, req->stream.size + req->extra);
+	req->buf = NULL;
+}
+
+/*
+ * Load several files at once. Reads of all requests are issued with ReadEx
+ * and kept in flight at the same time when the firmware supports revision 2
+ * of EFI_FILE_PROTOCOL, otherwise the files are read one by one.
+ *
+ * Requests with a NULL path are skipped. For every request, the loaded buffer
+ * and size are stored in buf and size like file_load_alloc() does, or buf is
+ * set to NULL and size to -1 on failure.
+ */
+void
+file_load_batch(File_Load_Request *reqs, size_t num)
+{
+	for (size_t i = 0; i < num; i++) {
+		File_Load_Request *req = &reqs[i];
+
+		req->buf	= NULL;
+		req->size	= -1;
+		req->pending	= 0;
+
+		if (!req->path || file_stream_open(&req->stream, req->path, 0))
+			continue;
+
+		size_t allocSize = req->stream.size + req->extra;
+		req->buf = req->type == FILE_ALLOC_PAGES ?
+				placement_alloc(allocSize, req->align,
+						req->placement) :
+				malloc(allocSize);
+		if (!req->buf) {
+			pr_err("Unable to allocate %lu bytes for %s, "
+			       "insufficient memory?\n", allocSize, req->path);
+			file_stream_close(&req->stream);
+			continue;
+		}
+
+		if (!file_read_async(req)) {
+			req->pending = 1;
+			continue;
+		}
+
+		if (file_stream_consume(&req->stream, req->buf,
+					req->stream.size, NULL, NULL) < 0)
+			file_load_release(req);
+		else
+			req->size = req->stream.size;
+
+		file_stream_close(&req->stream);
+	}
+
+	for (size_t i = 0; i < num; i++) {
+		File_Load_Request *req = &reqs[i];
+
+		if (!req->pending)
+			continue;
+
+		if (file_wait_async(req))
+			file_load_release(req);
+		else
+			req->size = req->stream.size;
 
-	efi_method(file, read, &bufSize, *buf);
+		req->pending = 0;
+		file_stream_close(&req->stream);
+	}
+}
+
+/*
+ * Names in directory listings are compared case-insensitively, as they
+ * mostly come from FAT.
+ */
+static int
+file_name_compare(const char *a, const char *b)
+{
+	while (*a && tolower(*a) == tolower(*b)) {
+		a++;
+		b++;
+	}
+
+	return tolower(*a) - tolower(*b);
+}
+
+/*
+ * Match name against a shell-like pattern, in which '*' matches any
+ * sequence of characters and '?' matches any single character.
+ */
+static int
+file_name_match(const char *pattern, const char *name)
+{
+	const char *star = NULL, *starName = NULL;
+
+	while (*name) {
+		if (*pattern == '*') {
+			star		= pattern++;
+			starName	= name;
+		} else if (*pattern == '?' ||
+			   (*pattern && tolower(*pattern) == tolower(*name))) {
+			pattern++;
+			name++;
+		} else if (star) {
+			/* Let the last '*' swallow one more character */
+			pattern		= star + 1;
+			name		= ++starName;
+		} else {
+			return 0;
+		}
+	}
+
+	while (*pattern == '*')
+		pattern++;
+
+	return !*pattern;
+}
+
+/*
+ * Read every record of dir, and build the sorted listing out of them.
+ */
+static int
+file_dir_read(Efi_File_Protocol *file, File_Stats *stats, File_Dir *dir)
+{
+	size_t infoSize = sizeof(Efi_File_Info) + 256 * sizeof(wchar_t);
+	Efi_File_Info *info = arena_alloc(infoSize);
+	size_t namesSize = 0;
+	/* names may move while growing, entries are pointed into it at last */
+	size_t *nameOffsets = NULL;
+	int ret = -1;
+
+	while (1) {
+		uint_native size = infoSize;
+		uint64_t start = timer_read();
+		Efi_Status status = efi_method(file, read, &size, info);
+
+		if (stats) {
+			stats->reads++;
+			stats->readTicks += timer_read() - start;
+		}
+
+		if (status == TO_EFI_ERRNO(EFI_BUFFER_TOO_SMALL)) {
+			infoSize	= size;
+			info		= arena_alloc(infoSize);
+			continue;
+		}
+
+		if (status != EFI_SUCCESS)
+			goto out;
+
+		if (!size)
+			break;
+
+		if (stats)
+			stats->bytes += size;
+
+		size_t nameLen = wcs2str(NULL, info->fileName);
+		if ((nameLen == 1 && info->fileName[0] == '.') ||
+		    (nameLen == 2 && info->fileName[0] == '.' &&
+		     info->fileName[1] == '.'))
+			continue;
+
+		dir->entries = realloc_grow(dir->entries, (dir->num + 1) *
+					    sizeof(File_Dir_Entry));
+		nameOffsets = realloc_grow(nameOffsets, (dir->num + 1) *
+					   sizeof(*nameOffsets));
+		dir->names = realloc_grow(dir->names, namesSize + nameLen + 1);
+
+		wcs2str(dir->names + namesSize, info->fileName);
+
+		nameOffsets[dir->num] = namesSize;
+		dir->entries[dir->num++] = (File_Dir_Entry) {
+			.size	= info->fileSize,
+			.isDir	= !!(info->attribute & EFI_FILE_DIRECTORY),
+		};
+		namesSize += nameLen + 1;
+	}
+
+	for (size_t i = 0; i < dir->num; i++)
+		dir->entries[i].name = dir->names + nameOffsets[i];
+
+	/* Insertion sort, directories on ESP are small */
+	for (size_t i = 1; i < dir->num; i++) {
+		File_Dir_Entry e = dir->entries[i];
+		size_t j = i;
+
+		for (; j && file_name_compare(dir->entries[j - 1].name,
+					      e.name) > 0; j--)
+			dir->entries[j] = dir->entries[j - 1];
+
+		dir->entries[j] = e;
+	}
+
+	ret = 0;
+out:
+	free(nameOffsets);
+	return ret;
+}
+
+/*
+ * Return the listing of directory path, reading it through the firmware only
+ * the first time. The listing is sorted by name, and stays valid until loli
+ * exits.
+ *
+ * Return NULL if path doesn't exist or isn't a directory.
+ */
+const File_Dir *
+file_dir_open(const char *path)
+{
+	Arena_Mark mark = arena_mark();
+	wchar_t *wpath = file_fix_str_path(path);
+	File_Dir *dir;
+
+	for (dir = dirCache; dir; dir = dir->next) {
+		if (!wcscmp(dir->path, wpath))
+			goto out;
+	}
+
+	Efi_File_Info *info;
+	File_Stats *stats;
+	int cached;
+	Efi_File_Protocol *file = file_open_cached(path, &info, &cached,
+						   &stats);
+	if (!file)
+		goto out;
+
+	int isDir = info->attribute & EFI_FILE_DIRECTORY;
+	if (!cached)
+		free(info);
+
+	dir = malloc(sizeof(*dir));
+	*dir = (File_Dir) { 0 };
+
+	if (!isDir || file_dir_read(file, stats, dir)) {
+		free(dir->entries);
+		free(dir->names);
+		free(dir);
+		dir = NULL;
+	} else {
+		dir->path	= file_dup_path(wpath);
+		dir->next	= dirCache;
+		dirCache	= dir;
+	}
 
 	file_close(file);
-	return (int64_t)bufSize;
+
+out:
+	arena_reset(mark);
+	return dir;
+}
+
+/*
+ * Iterate over entries of dir matching pattern in sorted order. Pass NULL as
+ * last to get the first match.
+ *
+ * Return the next matching entry, or NULL if there's no more.
+ */
+const File_Dir_Entry *
+file_dir_match(const File_Dir *dir, const char *pattern,
+	       const File_Dir_Entry *last)
+{
+	const File_Dir_Entry *e = last ? last + 1 : dir->entries;
+
+	for (; e < dir->entries + dir->num; e++) {
+		if (file_name_match(pattern, e->name))
+			return e;
+	}
+
+	return NULL;
 }
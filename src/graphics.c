@@ -11,6 +11,7 @@
 #include <string.h>
 #include <memory.h>
 #include <misc.h>
+#include <simd.h>
 
 typedef struct Frame_Buffer {
 	Efi_Graphics_Output_Protocol *gop;
@@ -45,8 +46,9 @@ scroll_up(Frame_Buffer *fb)
 	size_t moveSize = console_line_bytes(fb) * (CONSOLE_HEIGHT - 1);
 	uint8_t *buf = fb->buf;
 
-	memmove(buf, buf + console_line_bytes(fb), moveSize);
-	memset(buf + moveSize, 0, console_line_bytes(fb));
+	/* Lines move upwards, which a forward copy deals with */
+	simd_copy(buf, buf + console_line_bytes(fb), moveSize);
+	simd_fill(buf + moveSize, 0, console_line_bytes(fb));
 
 	fb->damagedLeft = fb->damagedUp = 0;
 	fb->damagedRight	= fb->width - 1;
@@ -230,7 +232,7 @@ gop_setup_mode(Frame_Buffer *fb, Efi_Graphics_Output_Protocol *gop,
 
 	reset_damaged_region(fb);
 
-	memset(fb->buf, 0, fbSize);
+	simd_fill(fb->buf, 0, fbSize);
 
 	uint32_t pixel = 0;
 	efi_method(gop, blt, &pixel, EFI_BLT_VIDEO_FILL, 0, 0, 0, 0,
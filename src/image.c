@@ -0,0 +1,207 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/src/image.c
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#include <efidef.h>
+
+#include <image.h>
+#include <misc.h>
+
+#define DOS_MAGIC		0x5a4d		// "MZ"
+#define DOS_PE_OFFSET		0x3c
+#define PE_MAGIC		0x00004550	// "PE\0\0"
+#define PE_OPT_MAGIC_PE32PLUS	0x20b
+#define PE_COFF_HEADER_SIZE	24
+#define PE_SECTION_SIZE		40
+
+/* Offsets in the PE32+ optional header */
+#define PE_OPT_SECTION_ALIGN	32
+#define PE_OPT_SIZE_OF_IMAGE	56
+
+/*
+ * The kernel buffer is over-allocated by the alignment, refuse ones larger
+ * than any real kernel uses.
+ */
+#define PE_SECTION_ALIGN_MAX	(2 << 20)
+
+#define PE_MACHINE_X86_64	0x8664
+#define PE_MACHINE_AARCH64	0xaa64
+#define PE_MACHINE_RISCV64	0x5064
+#define PE_MACHINE_LOONGARCH64	0x6264
+
+#if defined(LOLI_TARGET_X86_64)
+#define PE_MACHINE_NATIVE	PE_MACHINE_X86_64
+#elif defined(LOLI_TARGET_AARCH64)
+#define PE_MACHINE_NATIVE	PE_MACHINE_AARCH64
+#elif defined(LOLI_TARGET_RISCV64)
+#define PE_MACHINE_NATIVE	PE_MACHINE_RISCV64
+#elif defined(LOLI_TARGET_LOONGARCH64)
+#define PE_MACHINE_NATIVE	PE_MACHINE_LOONGARCH64
+#endif
+
+/* Linux arm64 and RISC-V Image headers share the same layout */
+#define LINUX_IMAGE_MAGIC_OFFSET	0x38
+#define LINUX_IMAGE_MAGIC_ARM64		0x644d5241	// "ARM\x64"
+#define LINUX_IMAGE_MAGIC_RISCV		0x05435352	// "RSC\x05"
+#define LINUX_IMAGE_SIZE_OFFSET		0x10
+
+static uint16_t
+le16(const uint8_t *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static uint32_t
+le32(const uint8_t *p)
+{
+	return le16(p) | ((uint32_t)le16(p + 2) << 16);
+}
+
+static uint64_t
+le64(const uint8_t *p)
+{
+	return le32(p) | ((uint64_t)le32(p + 4) << 32);
+}
+
+/*
+ * Check the Linux arm64/RISC-V Image header, which coexists with the DOS
+ * header when the kernel comes with an EFI stub.
+ */
+static int
+check_linux_image(const uint8_t *h, size_t size, uint64_t fileSize, int isPe)
+{
+	if (size < LINUX_IMAGE_MAGIC_OFFSET + 4)
+		return 0;
+
+	uint32_t magic = le32(h + LINUX_IMAGE_MAGIC_OFFSET);
+	if (magic != LINUX_IMAGE_MAGIC_ARM64 &&
+	    magic != LINUX_IMAGE_MAGIC_RISCV)
+		return 0;
+
+	if (!isPe) {
+		pr_err("kernel is a bare %s Image without EFI stub\n",
+		       magic == LINUX_IMAGE_MAGIC_ARM64 ? "arm64" : "RISC-V");
+		return -1;
+	}
+
+	/* image_size covers BSS as well, thus is never smaller than the file */
+	uint64_t imageSize = le64(h + LINUX_IMAGE_SIZE_OFFSET);
+	if (imageSize && imageSize < fileSize) {
+		pr_err("kernel Image size %lu is smaller than the file %lu\n",
+		       imageSize, fileSize);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Check the PE headers, including the section table if it's within size.
+ * Sections going beyond the end of file indicate a truncated image.
+ */
+static int
+check_pe(const uint8_t *h, size_t size, uint64_t fileSize)
+{
+	uint32_t peOffset = le32(h + DOS_PE_OFFSET);
+
+	if (peOffset > size - PE_COFF_HEADER_SIZE - 2 ||
+	    le32(h + peOffset) != PE_MAGIC) {
+		pr_err("kernel has no valid PE header\n");
+		return -1;
+	}
+
+	const uint8_t *coff = h + peOffset + 4;
+	uint16_t machine = le16(coff);
+	if (machine != PE_MACHINE_NATIVE) {
+		pr_err("kernel is built for machine 0x%x, not 0x%x\n",
+		       machine, PE_MACHINE_NATIVE);
+		return -1;
+	}
+
+	const uint8_t *opt = h + peOffset + PE_COFF_HEADER_SIZE;
+	if (le16(opt) != PE_OPT_MAGIC_PE32PLUS) {
+		pr_err("kernel isn't a PE32+ image\n");
+		return -1;
+	}
+
+	uint16_t sectionNum = le16(coff + 2);
+	uint16_t optSize = le16(coff + 16);
+	size_t sectionOffset = peOffset + PE_COFF_HEADER_SIZE + optSize;
+
+	if (optSize < PE_OPT_SIZE_OF_IMAGE + 4 ||
+	    sectionOffset > size) {
+		pr_err("kernel has a truncated PE optional header\n");
+		return -1;
+	}
+
+	uint32_t align = le32(opt + PE_OPT_SECTION_ALIGN);
+	uint64_t imageSize = le32(opt + PE_OPT_SIZE_OF_IMAGE);
+	if (!align || align & (align - 1) || align > PE_SECTION_ALIGN_MAX ||
+	    !imageSize) {
+		pr_err("kernel has a bad section alignment 0x%x or image size "
+		       "%lu\n", align, imageSize);
+		return -1;
+	}
+
+	if (sectionOffset + sectionNum * PE_SECTION_SIZE > size)
+		return 0;
+
+	for (uint16_t i = 0; i < sectionNum; i++) {
+		const uint8_t *sec = h + sectionOffset + i * PE_SECTION_SIZE;
+		uint64_t rawSize = le32(sec + 16), rawOffset = le32(sec + 20);
+		uint64_t virtSize = le32(sec + 8), virtAddr = le32(sec + 12);
+
+		if (rawSize && rawOffset + rawSize > fileSize) {
+			pr_err("kernel is truncated, section %d ends at %lu\n",
+			       i, rawOffset + rawSize);
+			return -1;
+		}
+
+		if (virtAddr + virtSize > imageSize) {
+			pr_err("kernel section %d goes beyond image size %lu\n",
+			       i, imageSize);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Validate the first size bytes of a kernel image, whose full size is
+ * fileSize, before loading the whole image.
+ *
+ * Return 0 if it looks bootable, otherwise print the reason and return -1.
+ */
+int
+image_check_header(const void *header, size_t size, uint64_t fileSize)
+{
+	const uint8_t *h = header;
+	int isPe = size >= DOS_PE_OFFSET + 4 && le16(h) == DOS_MAGIC;
+
+	if (check_linux_image(h, size, fileSize, isPe))
+		return -1;
+
+	if (!isPe) {
+		pr_err("kernel isn't an EFI image\n");
+		return -1;
+	}
+
+	return check_pe(h, size, fileSize);
+}
+
+/*
+ * Return the section alignment of a kernel image, whose header has passed
+ * image_check_header().
+ */
+uint32_t
+image_get_alignment(const void *header)
+{
+	const uint8_t *h = header;
+	const uint8_t *opt = h + le32(h + DOS_PE_OFFSET) + PE_COFF_HEADER_SIZE;
+
+	return le32(opt + PE_OPT_SECTION_ALIGN);
+}
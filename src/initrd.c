@@ -2,6 +2,7 @@
 
 #include <string.h>
 #include <memory.h>
+#include <simd.h>
 
 #include <efidef.h>
 #include <efiboot.h>
@@ -41,6 +42,10 @@ typedef struct Initrd_Load_File2_Protocol {
 	size_t size;
 } Initrd_Load_File2_Protocol;
 
+/* Only one initrd could be installed, as its device path is fixed */
+static Efi_Handle initrdHandle;
+static Initrd_Load_File2_Protocol *initrdProtocolInstalled;
+
 #ifdef LOLI_TARGET_X86_64
 Efi_Status
 _initrd_load_file
@@ -65,7 +70,7 @@ initrd_load_file
 		goto out;
 	}
 
-	memcpy(buffer, initrdProtocol->base, initrdProtocol->size);
+	simd_copy(buffer, initrdProtocol->base, initrdProtocol->size);
 
 out:
 	*bufferSize = initrdProtocol->size;
@@ -110,6 +115,9 @@ initrd_setup(void *base, size_t size)
 		goto uninstallDevicePath;
 	}
 
+	initrdHandle			= initrd;
+	initrdProtocolInstalled		= initrdProtocol;
+
 	return 0;
 
 uninstallDevicePath:
@@ -120,3 +128,27 @@ destroyProtocol:
 
 	return ret;
 }
+
+/*
+ * Uninstall the initrd set up by initrd_setup(), if any, so that another one
+ * could be installed later. The initrd buffer is left to the caller.
+ */
+void
+initrd_remove(void)
+{
+	if (!initrdHandle)
+		return;
+
+	Efi_Guid loadFile2Guid = EFI_LOAD_FILE2_PROTOCOL_GUID;
+	efi_call(gBS->uninstallProtocolInterface, initrdHandle,
+		 &loadFile2Guid, initrdProtocolInstalled);
+
+	Efi_Guid dpGuid = EFI_DEVICE_PATH_PROTOCOL_GUID;
+	efi_call(gBS->uninstallProtocolInterface, initrdHandle, &dpGuid,
+		 initrdDevicePath);
+
+	free(initrdProtocolInstalled);
+
+	initrdHandle			= NULL;
+	initrdProtocolInstalled		= NULL;
+}
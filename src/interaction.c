@@ -139,16 +139,18 @@ getchar_timeout(int timeout)
 char *
 getline_timeout(int timeout)
 {
-	size_t buflen = 16, strlen = 0;
-	char *s = malloc(buflen);
+	size_t strlen = 0;
+	char *s = realloc_grow(NULL, 1);
 	int c;
 
 	do {
 		c = getchar_timeout(timeout);
 		timeout = 0;
 
-		if (c == EOF)
+		if (c == EOF) {
+			free(s);
 			return NULL;
+		}
 
 		if (c == L'\b' && strlen) {
 			printf("\b \b");
@@ -160,11 +162,9 @@ getline_timeout(int timeout)
 		} else {
 			printf("%c", c);
 
+			/* Leave room for the terminator */
 			strlen++;
-			if (strlen == buflen) {
-				buflen += 32;
-				s = realloc(s, strlen, buflen);
-			}
+			s = realloc_grow(s, strlen + 1);
 
 			s[strlen - 1] = c;
 		}
@@ -21,26 +21,135 @@
 #include <serial.h>
 #include <initrd.h>
 #include <menu.h>
+#include <bench.h>
+#include <image.h>
+#include <placement.h>
+#include <ext4.h>
 
 #define LOLI_CFG "loli.cfg"
+/* Nesting of "include" directives, deeper ones are ignored */
+#define CFG_INCLUDE_DEPTH	16
+/* Pairs to make room for per byte of a configuration before parsing it */
+#define CFG_PAIR_GUESS(size)	((size) / 16 + 16)
+
+/*
+ * A configuration file loaded for "include" directives. Each path is loaded
+ * once no matter how many times it's included, and files with the same content
+ * as an earlier one are dropped in favor of it, thus parsed only once as well.
+ */
+typedef struct Cfg_File {
+	char *path;
+	char *buf;
+	Extlinux_Pair *pairs;
+	unsigned long int pairNum;
+	int64_t size;
+
+	/* The earlier file with the same content, if any */
+	struct Cfg_File *same;
+	/* Set while the file is being expanded, for detecting cycles */
+	int including;
+	struct Cfg_File *next;
+} Cfg_File;
+
+/*
+ * Pairs of the configuration with "include" directives expanded, values point
+ * into buffers of files.
+ */
+typedef struct {
+	Cfg_File *files;
+	Extlinux_Pair *pairs;
+	unsigned long int pairNum;
+} Cfg;
+
+/*
+ * Changes made to the system while loading an entry, which are undone in
+ * reverse order by entry_rollback() if the entry fails to load.
+ */
+typedef enum {
+	ENTRY_UNDO_PAGES,
+	ENTRY_UNDO_POOL,
+	ENTRY_UNDO_IMAGE,
+	ENTRY_UNDO_CONFIG_TABLE,
+	ENTRY_UNDO_INITRD,
+} Entry_Undo_Type;
+
+typedef struct {
+	Entry_Undo_Type type;
+	/* Buffer, image handle or the previous configuration table */
+	void *p;
+	size_t size;
+	Efi_Guid guid;
+} Entry_Undo;
+
+#define ENTRY_UNDO_MAX	8
 
 typedef struct {
 	Efi_Handle kernelHandle;
+
+	Entry_Undo undo[ENTRY_UNDO_MAX];
+	int undoNum;
 } Boot_Entry;
 
 static void
-setup_append(Efi_Handle kernelHandle, char *append)
+entry_record(Boot_Entry *entry, Entry_Undo undo)
+{
+	if (entry->undoNum == ENTRY_UNDO_MAX)
+		panic("Too many changes to undo");
+
+	entry->undo[entry->undoNum++] = undo;
+}
+
+/*
+ * Undo every change recorded while loading the entry, leaving the system as
+ * it was before, thus another entry could be tried.
+ */
+static void
+entry_rollback(Boot_Entry *entry)
+{
+	while (entry->undoNum) {
+		Entry_Undo *undo = &entry->undo[--entry->undoNum];
+
+		switch (undo->type) {
+		case ENTRY_UNDO_PAGES:
+			free_pages(undo->p, undo->size);
+			break;
+		case ENTRY_UNDO_POOL:
+			free(undo->p);
+			break;
+		case ENTRY_UNDO_IMAGE:
+			efi_call(gBS->unloadImage, undo->p);
+			break;
+		case ENTRY_UNDO_CONFIG_TABLE:
+			/* Installing NULL removes the table */
+			efi_call(gBS->installConfigurationTable, &undo->guid,
+				 undo->p);
+			break;
+		case ENTRY_UNDO_INITRD:
+			initrd_remove();
+			break;
+		}
+	}
+
+	entry->kernelHandle = NULL;
+}
+
+static void
+setup_append(Boot_Entry *entry, char *append)
 {
 	Efi_Loaded_Image_Protocol *kernelImage = NULL;
 
-	efi_handle_protocol(kernelHandle, EFI_LOADED_IMAGE_PROTOCOL_GUID,
-			    &kernelImage);
+	efi_handle_protocol(entry->kernelHandle,
+			    EFI_LOADED_IMAGE_PROTOCOL_GUID, &kernelImage);
 
 	size_t appendLen = strlen(append) + 1;
 	size_t wAppendLen = appendLen * sizeof(wchar_t);
 	wchar_t *wAppend = malloc(wAppendLen);
 
 	str2wcs(wAppend, append);
+	entry_record(entry, (Entry_Undo) {
+		.type	= ENTRY_UNDO_POOL,
+		.p	= wAppend,
+	});
 
 	kernelImage->loadOptions	= wAppend;
 	kernelImage->loadOptionSize	= wAppendLen;
@@ -67,134 +176,355 @@ load_efi_image(Boot_Entry *entry, void *kernelBase, int64_t kernelSize)
 			&entry->kernelHandle) != EFI_SUCCESS;
 }
 
+/*
+ * Validate headers of the kernel and FDT with partial reads, rejecting a bad
+ * entry before loading any whole file. Section alignment of the kernel is
+ * stored in align.
+ */
 static int
-load_and_validate_entry(const char *p, Boot_Entry *entry)
+check_entry_headers(const char *kernel, const char *fdt, uint32_t *align)
 {
-	/* Releasing of temporary objects is delayed until everything sets up */
-	char *kernel = menu_get_pair(p, "kernel");
-	if (!kernel) {
-		pr_err("No kernel defined for the entry!\n");
-		goto out_err;
-	}
+	uint64_t header[IMAGE_HEADER_SIZE / sizeof(uint64_t)];
 
-	int64_t kernelSize = file_get_size(kernel);
-	if (kernelSize < 0) {
+	int64_t size = file_get_size(kernel);
+	int64_t headerSize = size < 0 ? -1 :
+		file_read_partial(kernel, 0, header, sizeof(header));
+	if (headerSize < 0) {
 		pr_err("Can't load kernel %s\n", kernel);
-		goto out_err;
+		return -1;
 	}
 
-	void *kernelBase = malloc_pages(kernelSize);
-	if (!kernelBase) {
-		pr_err("Unable to allocate memory for kernel image, "
-		       "insufficient memory?\n");
-		goto out_err;
+	if (image_check_header(header, headerSize, size)) {
+		pr_err("Invalid kernel %s\n", kernel);
+		return -1;
 	}
 
-	int64_t ret = file_load(kernel, &kernelBase);
-	if (ret < 0) {
-		pr_err("Can't load kernel %s\n", kernel);
-		goto free_kernel;
+	*align = image_get_alignment(header);
+
+	if (!fdt)
+		return 0;
+
+	size = file_get_size(fdt);
+	headerSize = size < 0 ? -1 :
+		file_read_partial(fdt, 0, header, sizeof(Fdt_Header));
+	if (headerSize < 0) {
+		pr_err("Can't load FDT %s\n", fdt);
+		return -1;
 	}
 
-	if (load_efi_image(entry, kernelBase, kernelSize)) {
-		pr_err("Can't load kernel %s\n", kernel);
-		goto free_kernel_base;
+	if (headerSize < (int64_t)sizeof(Fdt_Header) ||
+	    fdt_check_header((Fdt_Header *)header, size)) {
+		pr_err("Invalid FDT %s\n", fdt);
+		return -1;
 	}
 
-	pr_info("Kernel %s, size = %lu\n", kernel, kernelSize);
+	return 0;
+}
+
+enum {
+	ENTRY_FILE_KERNEL,
+	ENTRY_FILE_FDT,
+	ENTRY_FILE_INITRD,
+	ENTRY_FILE_NUM,
+};
+
+/*
+ * Load the entry p and prepare everything it needs for booting, recording
+ * the changes in entry. On failure, they're all rolled back and -1 is
+ * returned.
+ */
+static int
+load_and_validate_entry(const Extlinux_Entry *p, Boot_Entry *entry)
+{
+	/* Strings are allocated from the arena, reset by the caller */
+	char *kernel = menu_get_pair(p, EXTLINUX_KEY_KERNEL);
+	if (!kernel) {
+		pr_err("No kernel defined for the entry!\n");
+		goto out_err;
+	}
 
-	char *fdt = menu_get_pair(p, "fdt");
+	char *fdt = menu_get_pair(p, EXTLINUX_KEY_FDT);
 	if (!fdt)
-		fdt = menu_get_pair(p, "devicetree");
+		fdt = menu_get_pair(p, EXTLINUX_KEY_DEVICETREE);
+
+	char *initrd = menu_get_pair(p, EXTLINUX_KEY_INITRD);
+
+	uint32_t align;
+	if (check_entry_headers(kernel, fdt, &align))
+		goto out_err;
+
+	/*
+	 * Keep reads of all files of the entry in flight at the same time.
+	 * The kernel buffer follows the section alignment of the image, but
+	 * LoadImage() copies it anyway: aligning the source buffer doesn't
+	 * change where the loaded image ends up.
+	 *
+	 * Both the kernel, which LoadImage() copies, and the initrd are put
+	 * at the top of memory, keeping low memory contiguous for the loaded
+	 * image and the decompressed kernel.
+	 */
+	File_Load_Request files[ENTRY_FILE_NUM] = {
+		[ENTRY_FILE_KERNEL] = {
+			.path		= kernel,
+			.type		= FILE_ALLOC_PAGES,
+			.align		= align,
+			.placement	= PLACEMENT_HIGH,
+		},
+		[ENTRY_FILE_FDT] = {
+			.path		= fdt,
+			.type		= FILE_ALLOC_POOL,
+		},
+		[ENTRY_FILE_INITRD] = {
+			.path		= initrd,
+			.type		= FILE_ALLOC_PAGES,
+			.placement	= PLACEMENT_HIGH,
+		},
+	};
+	file_load_batch(files, ENTRY_FILE_NUM);
+
+	/* Check every file before making any change to the system */
+	File_Load_Request *kernelFile = &files[ENTRY_FILE_KERNEL];
+	if (kernelFile->size < 0) {
+		pr_err("Can't load kernel %s\n", kernel);
+		goto free_files;
+	}
 
+	File_Load_Request *fdtFile = &files[ENTRY_FILE_FDT];
 	if (fdt) {
-		int64_t fdtSize = file_get_size(fdt);
-		if (fdtSize < 0) {
+		if (fdtFile->size < 0) {
 			pr_err("Can't load FDT %s\n", fdt);
-			goto unload_image;
+			goto free_files;
 		}
-		if (fdtSize < sizeof(Fdt_Header)) {
+		if (fdtFile->size < (int64_t)sizeof(Fdt_Header) ||
+		    fdt_check_header(fdtFile->buf, fdtFile->size)) {
 			pr_err("Invalid FDT %s\n", fdt);
-			goto unload_image;
-		}
-		void *fdtBase = malloc(fdtSize);
-		int64_t ret = file_load(fdt, &fdtBase);
-		if (ret < 0) {
-			pr_err("Can't load FDT %s\n", fdt);
-			free(fdtBase);
-			goto unload_image;
+			goto free_files;
 		}
-		pr_info("FDT: %s, size = %lu\n", fdt, ret);
-		fdt_fixup_and_load((Fdt_Header *)fdtBase);
-		free(fdtBase);
+	}
+
+	File_Load_Request *initrdFile = &files[ENTRY_FILE_INITRD];
+	if (initrd && initrdFile->size < 0) {
+		pr_err("Can't load initrd %s\n", initrd);
+		goto free_files;
+	}
+
+	if (load_efi_image(entry, kernelFile->buf, kernelFile->size)) {
+		pr_err("Can't load kernel %s\n", kernel);
+		goto free_files;
+	}
+
+	entry_record(entry, (Entry_Undo) {
+		.type	= ENTRY_UNDO_IMAGE,
+		.p	= entry->kernelHandle,
+	});
+
+	/* LoadImage() has made its own copy of the image */
+	file_load_release(kernelFile);
+
+	pr_info("Kernel %s, size = %lu\n", kernel, kernelFile->size);
+
+	if (fdt) {
+		pr_info("FDT: %s, size = %lu\n", fdt, fdtFile->size);
+
+		Efi_Guid dtbGuid = EFI_DTB_TABLE_GUID;
+		void *oldFdt = efi_get_configuration_table(dtbGuid);
+
+		entry_record(entry, (Entry_Undo) {
+			.type	= ENTRY_UNDO_POOL,
+			.p	= fdt_fixup_and_load((Fdt_Header *)fdtFile->buf),
+		});
+		entry_record(entry, (Entry_Undo) {
+			.type	= ENTRY_UNDO_CONFIG_TABLE,
+			.p	= oldFdt,
+			.guid	= dtbGuid,
+		});
+
+		file_load_release(fdtFile);
 	} else {
 		pr_info("FDT: (none)\n");
 	}
 
-	char *initrd = menu_get_pair(p, "initrd");
 	if (initrd) {
-		int64_t initrdSize = file_get_size(initrd);
-		if (initrdSize < 0) {
-			pr_err("Can't load initrd %s\n", initrd);
-			goto unload_image;
-		}
+		pr_info("Initrd %s, size = %lu\n", initrd, initrdFile->size);
 
-		void *initrdBase = malloc_pages(initrdSize);
-		if (!initrdBase) {
-			pr_err("Unable to allocate memory for initrd, "
-			       "insufficient memory?\n");
-			goto unload_image;
-		}
+		/* The buffer is served to the kernel, thus owned by the entry */
+		entry_record(entry, (Entry_Undo) {
+			.type	= ENTRY_UNDO_PAGES,
+			.p	= initrdFile->buf,
+			.size	= initrdFile->size,
+		});
 
-		initrdSize = file_load(initrd, &initrdBase);
-		if (initrdSize < 0) {
-			pr_err("Can't load initrd %s\n", initrd);
-			goto unload_image;
-		}
+		int ret = initrd_setup(initrdFile->buf, initrdFile->size);
+		initrdFile->buf = NULL;
 
-		pr_info("Initrd %s, size = %lu\n", initrd, initrdSize);
+		if (ret) {
+			pr_err("Can't set up initrd %s\n", initrd);
+			goto free_files;
+		}
 
-		initrd_setup(initrdBase, initrdSize);
+		entry_record(entry, (Entry_Undo) {
+			.type	= ENTRY_UNDO_INITRD,
+		});
 	} else {
 		pr_info("Initrd: (none)\n");
 	}
 
-	char *append = menu_get_pair(p, "append");
+	char *append = menu_get_pair(p, EXTLINUX_KEY_APPEND);
 	pr_info("Append: %s\n", append ? append : "(none)");
 
 	if (append)
-		setup_append(entry->kernelHandle, append);
-
-	free(kernel);
-	free(append);
+		setup_append(entry, append);
 
 	return 0;
-unload_image:
-	efi_call(gBS->unloadImage, entry->kernelHandle);
-free_kernel_base:
-	free_pages(kernelBase, kernelSize);
-free_kernel:
-	free(kernel);
+free_files:
+	for (int i = 0; i < ENTRY_FILE_NUM; i++)
+		file_load_release(&files[i]);
 out_err:
+	entry_rollback(entry);
 	return -1;
 }
 
-static char *
-load_cfg(void)
+/*
+ * Parse the text of file once, retrying with the exact number of pairs if
+ * there are more than guessed.
+ */
+static void
+cfg_file_parse(Cfg_File *file)
+{
+	unsigned long int pairMax = CFG_PAIR_GUESS(file->size);
+
+	while (1) {
+		file->pairs = malloc(sizeof(*file->pairs) * pairMax);
+		file->pairNum = extlinux_parse(file->buf, file->pairs,
+					       pairMax);
+		if (file->pairNum <= pairMax)
+			return;
+
+		pairMax = file->pairNum;
+		free(file->pairs);
+	}
+}
+
+/*
+ * Return the file at path, which is loaded and parsed on the first lookup, or
+ * the earlier file with the same content. Return NULL if it couldn't be
+ * loaded.
+ */
+static Cfg_File *
+cfg_file_get(Cfg *cfg, const char *path)
+{
+	Cfg_File *file;
+
+	for (file = cfg->files; file; file = file->next) {
+		if (strcmp(file->path, path))
+			continue;
+
+		if (!file->buf)
+			return NULL;
+
+		return file->same ? file->same : file;
+	}
+
+	file = malloc(sizeof(*file));
+	*file = (Cfg_File) {
+		.path	= malloc(strlen(path) + 1),
+		.next	= cfg->files,
+	};
+	strcpy(file->path, path);
+
+	/* Failures are remembered as well, and not retried */
+	cfg->files = file;
+
+	file->size = file_load_alloc(path, FILE_ALLOC_POOL, 1,
+				     (void **)&file->buf);
+	if (file->size < 0)
+		return NULL;
+
+	file->buf[file->size] = '\0';
+
+	for (Cfg_File *p = file->next; p; p = p->next) {
+		if (p->buf && !p->same && p->size == file->size &&
+		    !memcmp(p->buf, file->buf, file->size)) {
+			free(file->buf);
+			file->buf	= p->buf;
+			file->same	= p;
+			return p;
+		}
+	}
+
+	cfg_file_parse(file);
+
+	return file;
+}
+
+/*
+ * Append pairs of file to cfg, with files included by it spliced in place of
+ * their "include" directives.
+ */
+static void
+cfg_expand(Cfg *cfg, Cfg_File *file, int depth)
 {
-	int64_t cfgSize = file_get_size(LOLI_CFG);
-	if (cfgSize < 0)
-		panic("Can't retrive size of configuration");
+	file->including = 1;
+
+	for (unsigned long int i = 0; i < file->pairNum; i++) {
+		const Extlinux_Pair *pair = &file->pairs[i];
+
+		if (pair->key != EXTLINUX_KEY_INCLUDE) {
+			size_t size = sizeof(*cfg->pairs) * (cfg->pairNum + 1);
+			cfg->pairs = realloc_grow(cfg->pairs, size);
+			cfg->pairs[cfg->pairNum++] = *pair;
+			continue;
+		}
 
-	char *cfg = malloc(cfgSize + 1);
+		Arena_Mark mark = arena_mark();
+		char *path = arena_strndup(pair->value.value, pair->value.len);
+		Cfg_File *included = cfg_file_get(cfg, path);
+
+		if (!included)
+			pr_err("Can't include %s, ignored\n", path);
+		else if (included->including)
+			pr_err("Include cycle at %s, ignored\n", path);
+		else if (depth >= CFG_INCLUDE_DEPTH)
+			pr_err("Includes nest too deep at %s, ignored\n", path);
+		else
+			cfg_expand(cfg, included, depth + 1);
+
+		arena_reset(mark);
+	}
+
+	file->including = 0;
+}
+
+static void
+load_cfg(Cfg *cfg)
+{
+	*cfg = (Cfg) { 0 };
 
-	cfgSize = file_load(LOLI_CFG, (void **)&cfg);
-	if (cfgSize < 0)
+	Cfg_File *file = cfg_file_get(cfg, LOLI_CFG);
+	if (!file)
 		panic("Can't load configuration");
 
-	cfg[cfgSize] = '\0';
+	cfg_expand(cfg, file, 0);
+}
+
+static void
+free_cfg(Cfg *cfg)
+{
+	Cfg_File *next;
+
+	for (Cfg_File *file = cfg->files; file; file = next) {
+		next = file->next;
+
+		if (!file->same) {
+			free(file->buf);
+			free(file->pairs);
+		}
+
+		free(file->path);
+		free(file);
+	}
 
-	return cfg;
+	free(cfg->pairs);
 }
 
 static int
@@ -213,51 +543,49 @@ wait_for_boot_entry(int timeout)
 }
 
 static Boot_Entry
-cmdline_loop(const char *cfg)
+cmdline_loop(const Cfg *cfg)
 {
-	int timeout = menu_get_timeout(cfg);
-	int entryNum = 0, defaultEntry = -1;
+	Menu menu;
+	menu_load(&menu, cfg->pairs, cfg->pairNum);
+
+	int timeout = menu_get_timeout(&menu);
+	int entryNum = menu.index.entryNum, defaultEntry = -1;
 
-	size_t defaultEntryLen;
-	const char *defaultEntryName = extlinux_get_value(cfg, "default",
-							  &defaultEntryLen);
+	const Extlinux_Value *defaultEntryName =
+		&menu.index.global.values[EXTLINUX_KEY_DEFAULT];
 	/* Boot entry 0 by default when there's no default specified */
-	if (!defaultEntryName)
+	if (!defaultEntryName->value)
 		defaultEntry = 0;
 
-	for (const char *p = extlinux_next_entry(cfg, NULL);
-	     p;
-	     p = extlinux_next_entry(NULL, p)) {
-		size_t namelen = 0, titlelen = 0;
-		const char *name = extlinux_get_value(p, "label", &namelen);
-		const char *title = extlinux_get_value(p, "menu title",
-						       &titlelen);
+	for (int i = 0; i < entryNum; i++) {
+		const Extlinux_Entry *p = menu_get_nth_entry(&menu, i);
+		const Extlinux_Value *name = &p->values[EXTLINUX_KEY_LABEL];
+		const Extlinux_Value *title =
+			&p->values[EXTLINUX_KEY_MENU_TITLE];
 
-		if (!title) {
+		if (!title->value)
 			title = name;
-			titlelen = namelen;
-		}
 
-		printf("%d: ", entryNum);
-		puts_sized(title, titlelen);
+		printf("%d: ", i);
+		puts_sized(title->value, title->len);
 		printf("\n");
 
-		if (defaultEntryName && !strncmp(defaultEntryName, name,
-						 defaultEntryLen))
-			defaultEntry = entryNum;
-
-		entryNum++;
+		if (defaultEntryName->value &&
+		    defaultEntryName->len == name->len &&
+		    !strncmp(defaultEntryName->value, name->value,
+			     defaultEntryName->len))
+			defaultEntry = i;
 	}
 
 	/* No entry matches the specified default, complain but don't fail */
 	if (defaultEntry < 0) {
 		printf("Invalid default entry \"");
-		puts_sized(defaultEntryName, defaultEntryLen);
+		puts_sized(defaultEntryName->value, defaultEntryName->len);
 		printf("\", boot entry 0 by default\n");
 		defaultEntry = 0;
 	}
 
-	const char *entry = NULL;
+	const Extlinux_Entry *entry = NULL;
 	Boot_Entry bootEntry = { NULL };
 	while (1) {
 		int selectedEntry = wait_for_boot_entry(timeout);
@@ -269,11 +597,35 @@ cmdline_loop(const char *cfg)
 		timeout = 0;
 
 		if (selectedEntry >= 0 && selectedEntry < entryNum) {
-			entry = menu_get_nth_entry(cfg, selectedEntry);
-			if (!load_and_validate_entry(entry, &bootEntry))
+			/* Temporaries of an attempt are released at once */
+			Arena_Mark mark = arena_mark();
+			int ret;
+
+			entry = menu_get_nth_entry(&menu, selectedEntry);
+
+			/* Benchmark entries are run instead of booted */
+			char *benchFile = menu_get_pair(entry,
+							EXTLINUX_KEY_BENCHFILE);
+			if (benchFile) {
+				bench_file(benchFile);
+				arena_reset(mark);
+				continue;
+			}
+
+			char *memmap = menu_get_pair(&menu.index.global,
+						     EXTLINUX_KEY_MEMMAP);
+			if (memmap && atou(memmap) > 0)
+				placement_dump();
+
+			ret = load_and_validate_entry(entry, &bootEntry);
+			arena_reset(mark);
+
+			if (!ret) {
+				menu_free(&menu);
 				return bootEntry;
-			else
-				pr_err("Invalid entry\n");
+			}
+
+			pr_err("Invalid entry\n");
 		}
 	}
 
@@ -294,9 +646,21 @@ main(Efi_Handle imageHandle, Efi_System_Table *st)
 
 	printf("loli bootloader (%s built)\n", __DATE__);
 
-	char *cfg = load_cfg();
+#ifdef LOLI_EXT4
+	ext4_report();
+#endif
+
+	Cfg cfg;
+	load_cfg(&cfg);
+
+	Boot_Entry bootEntry = cmdline_loop(&cfg);
+
+	file_stats_report();
+	file_fini();
+	arena_fini();
+	free_cfg(&cfg);
 
-	Boot_Entry bootEntry = cmdline_loop(cfg);
+	memory_report();
 
 	int ret = efi_call(gBS->startImage, bootEntry.kernelHandle, NULL, NULL);
 	pr_err("Failed to start image: %d\n", ret);
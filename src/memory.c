@@ -5,23 +5,173 @@
  *	Copyright (c) 2024 Yao Zi.
  */
 
+/* Don't tag allocations made by the allocator itself */
+#define LOLI_MEMORY_INTERNAL
+
 #include <efi.h>
 #include <string.h>
 
 #include <memory.h>
 #include <misc.h>
 
+#define SIZE_TO_EFI_PAGES(size) ((size + 4095) >> 12)
+#define ALIGN_UP(x, a)		(((x) + (a) - 1) & ~((size_t)(a) - 1))
+
+/*
+ * Every pool allocation is prefixed with a header recording its usable
+ * capacity, which lets realloc() grow a block in place when it still fits.
+ * The header is 16 bytes to keep the alignment of pool memory.
+ */
+typedef struct {
+	size_t capacity;
+	Efi_Memory_Type type;
+	uint32_t reserved;
+} Memory_Header;
+
+#define MEMORY_ALIGN		16
+#define MEMORY_HEADER(p)	((Memory_Header *)(p) - 1)
+
+#ifdef LOLI_MEMTRACK
+
+#define MEMTRACK_RECORDS	1024
+
+/*
+ * A live allocation. tag points to a string literal describing the call
+ * site, which is set through gMemTag by macros in memory.h.
+ */
+typedef struct {
+	void *p;
+	size_t size;
+	const char *tag;
+	int isPages;
+} Memtrack_Record;
+
+static Memtrack_Record gMemRecords[MEMTRACK_RECORDS];
+
+static struct {
+	size_t poolCurrent, poolPeak;
+	size_t pagesCurrent, pagesPeak;
+	size_t allocatePool, freePool;
+	size_t allocatePages, freePages;
+	size_t untracked;
+} gMemStats;
+
+const char *gMemTag;
+
+#define memtrack_set_tag(tag)	(gMemTag = (tag))
+#define memtrack_count(call)	(gMemStats.call++)
+
+static void
+memtrack_add(void *p, size_t size, int isPages)
+{
+	const char *tag = gMemTag ? gMemTag : "(untagged)";
+	gMemTag = NULL;
+
+	Memtrack_Record *r = NULL;
+	for (int i = 0; i < MEMTRACK_RECORDS && !r; i++) {
+		if (!gMemRecords[i].p)
+			r = &gMemRecords[i];
+	}
+
+	/* Untracked allocations are left out of the byte counts */
+	if (!r) {
+		gMemStats.untracked++;
+		return;
+	}
+
+	*r = (Memtrack_Record) { p, size, tag, isPages };
+
+	if (isPages) {
+		gMemStats.pagesCurrent += size;
+		if (gMemStats.pagesCurrent > gMemStats.pagesPeak)
+			gMemStats.pagesPeak = gMemStats.pagesCurrent;
+	} else {
+		gMemStats.poolCurrent += size;
+		if (gMemStats.poolCurrent > gMemStats.poolPeak)
+			gMemStats.poolPeak = gMemStats.poolCurrent;
+	}
+}
+
+static void
+memtrack_remove(void *p)
+{
+	for (int i = 0; i < MEMTRACK_RECORDS; i++) {
+		Memtrack_Record *r = &gMemRecords[i];
+
+		if (r->p != p)
+			continue;
+
+		if (r->isPages)
+			gMemStats.pagesCurrent -= r->size;
+		else
+			gMemStats.poolCurrent -= r->size;
+
+		*r = (Memtrack_Record) { NULL };
+		return;
+	}
+}
+
+#else	// LOLI_MEMTRACK
+
+#define memtrack_set_tag(tag)		do { } while (0)
+#define memtrack_count(call)		do { } while (0)
+#define memtrack_add(p, size, isPages)	do { } while (0)
+#define memtrack_remove(p)		do { } while (0)
+
+#endif	// LOLI_MEMTRACK
+
+/*
+ * Print memory taken by loli and allocations still alive, only available
+ * when built with MEMTRACK.
+ */
+void
+memory_report(void)
+{
+#ifdef LOLI_MEMTRACK
+	pr_info("memory: pool %lu bytes (peak %lu), "
+		"pages %lu bytes (peak %lu)\n",
+		gMemStats.poolCurrent, gMemStats.poolPeak,
+		gMemStats.pagesCurrent, gMemStats.pagesPeak);
+	pr_info("memory: AllocatePool %lu, FreePool %lu, "
+		"AllocatePages %lu, FreePages %lu calls\n",
+		gMemStats.allocatePool, gMemStats.freePool,
+		gMemStats.allocatePages, gMemStats.freePages);
+
+	if (gMemStats.untracked)
+		pr_warn("memory: %lu allocations aren't tracked\n",
+			gMemStats.untracked);
+
+	for (int i = 0; i < MEMTRACK_RECORDS; i++) {
+		Memtrack_Record *r = &gMemRecords[i];
+
+		if (r->p)
+			pr_info("memory: live %s %p, %lu bytes, %s\n",
+				r->isPages ? "pages" : "pool", r->p, r->size,
+				r->tag);
+	}
+#endif
+}
+
 void *
 malloc_type(size_t size, Efi_Memory_Type type)
 {
-	void *addr;
+	size_t capacity = ALIGN_UP(size, MEMORY_ALIGN);
+	Memory_Header *h;
 	int ret = efi_call(gBS->allocatePool, type,
-			   (uint_native)size, &addr);
+			   (uint_native)(capacity + sizeof(*h)), (void **)&h);
+	memtrack_count(allocatePool);
 
 	if (ret != EFI_SUCCESS)
 		panic("Failed to allocate memory");
 
-	return addr;
+	*h = (Memory_Header) {
+		.capacity	= capacity,
+		.type		= type,
+	};
+
+	memtrack_add(h + 1, capacity, 0);
+
+	return h + 1;
 }
 
 void *
@@ -33,29 +183,79 @@ malloc(size_t size)
 void
 free(void *p)
 {
-	if (p)
-		efi_call(gBS->freePool, p);
+	if (!p)
+		return;
+
+	memtrack_remove(p);
+	memtrack_count(freePool);
+	efi_call(gBS->freePool, MEMORY_HEADER(p));
+}
+
+/*
+ * Return number of bytes usable in a block returned by malloc().
+ */
+size_t
+malloc_capacity(const void *p)
+{
+	return p ? ((const Memory_Header *)p - 1)->capacity : 0;
 }
 
+/*
+ * Resize p to size bytes. p is returned as is if its capacity covers size,
+ * otherwise the content is moved to a new block.
+ */
 void *
-realloc_type(void *p, Efi_Memory_Type type, size_t oldSize, size_t size)
+realloc_type(void *p, Efi_Memory_Type type, size_t size)
 {
-	void *new = NULL;
-	if (size) {
-		new = malloc_type(size, type);
-		memcpy(new, p, oldSize);
+	if (!size) {
+		free(p);
+		memtrack_set_tag(NULL);
+		return NULL;
 	}
-	free(p);
+
+	if (p && MEMORY_HEADER(p)->type == type &&
+	    MEMORY_HEADER(p)->capacity >= size) {
+		memtrack_set_tag(NULL);
+		return p;
+	}
+
+	void *new = malloc_type(size, type);
+	if (p) {
+		size_t oldSize = MEMORY_HEADER(p)->capacity;
+		memcpy(new, p, oldSize < size ? oldSize : size);
+		free(p);
+	}
+
 	return new;
 }
 
 void *
-realloc(void *p, size_t oldSize, size_t size)
+realloc(void *p, size_t size)
 {
-	return realloc_type(p, EFI_LOADER_DATA, oldSize, size);
+	return realloc_type(p, EFI_LOADER_DATA, size);
 }
 
-#define SIZE_TO_EFI_PAGES(size) ((size + 4095) >> 12)
+/*
+ * Make sure p could hold at least size bytes, growing it geometrically, thus
+ * appending to a buffer byte by byte costs amortized constant time. The
+ * content is preserved.
+ */
+void *
+realloc_grow(void *p, size_t size)
+{
+	size_t capacity = malloc_capacity(p);
+
+	if (capacity >= size) {
+		memtrack_set_tag(NULL);
+		return p;
+	}
+
+	capacity = capacity ? capacity * 2 : 32;
+	while (capacity < size)
+		capacity *= 2;
+
+	return realloc(p, capacity);
+}
 
 void *
 malloc_pages(size_t size)
@@ -64,12 +264,206 @@ malloc_pages(size_t size)
 	int ret = efi_call(gBS->allocatePages, 0, EFI_LOADER_DATA,
 			   SIZE_TO_EFI_PAGES(size),
 			   &addr);
-	return ret == EFI_SUCCESS ? addr : NULL;
+	memtrack_count(allocatePages);
+
+	if (ret != EFI_SUCCESS) {
+		memtrack_set_tag(NULL);
+		return NULL;
+	}
+
+	memtrack_add(addr, SIZE_TO_EFI_PAGES(size) << 12, 1);
+
+	return addr;
+}
+
+/*
+ * Allocate pages at exactly address, for images that must live at a fixed
+ * place. Return NULL if the range isn't free.
+ */
+void *
+malloc_pages_at(uint64_t address, size_t size)
+{
+	void *addr = (void *)(uintptr_t)address;
+	int ret = efi_call(gBS->allocatePages, ALLOCATE_ADDRESS,
+			   EFI_LOADER_DATA, SIZE_TO_EFI_PAGES(size), &addr);
+	memtrack_count(allocatePages);
+
+	if (ret != EFI_SUCCESS) {
+		memtrack_set_tag(NULL);
+		return NULL;
+	}
+
+	memtrack_add(addr, SIZE_TO_EFI_PAGES(size) << 12, 1);
+
+	return addr;
+}
+
+/*
+ * Allocate pages aligned to align, which must be a power of two, and ending
+ * below maxAddress unless it's MEMORY_ADDRESS_ANY. Alignments larger than a
+ * page are achieved by over-allocating then returning the unaligned head and
+ * the unused tail to the firmware, thus the result could still be released
+ * with free_pages(p, size).
+ */
+void *
+malloc_pages_aligned(size_t size, size_t align, uint64_t maxAddress)
+{
+	if (align < 4096)
+		align = 4096;
+
+	size_t pages = SIZE_TO_EFI_PAGES(size);
+	size_t slack = (align >> 12) - 1;
+	void *addr = (void *)(uintptr_t)maxAddress;
+	int ret = efi_call(gBS->allocatePages,
+			   maxAddress == MEMORY_ADDRESS_ANY ?
+				ALLOCATE_ANY_PAGES : ALLOCATE_MAX_ADDRESS,
+			   EFI_LOADER_DATA, pages + slack, &addr);
+	memtrack_count(allocatePages);
+
+	if (ret != EFI_SUCCESS) {
+		memtrack_set_tag(NULL);
+		return NULL;
+	}
+
+	uint8_t *aligned = (uint8_t *)ALIGN_UP((uintptr_t)addr, align);
+	size_t head = (aligned - (uint8_t *)addr) >> 12;
+
+	if (head) {
+		efi_call(gBS->freePages, addr, head);
+		memtrack_count(freePages);
+	}
+
+	if (slack - head) {
+		efi_call(gBS->freePages, aligned + (pages << 12), slack - head);
+		memtrack_count(freePages);
+	}
+
+	memtrack_add(aligned, pages << 12, 1);
+
+	return aligned;
 }
 
 void
 free_pages(void *p, size_t size)
 {
-	if (p)
-		efi_call(gBS->freePages, p, SIZE_TO_EFI_PAGES(size));
+	if (!p)
+		return;
+
+	memtrack_remove(p);
+	memtrack_count(freePages);
+	efi_call(gBS->freePages, p, SIZE_TO_EFI_PAGES(size));
+}
+
+/*
+ * Arena for short-lived objects, like temporary paths and values parsed from
+ * the configuration. Objects are bump-allocated from regions obtained by
+ * malloc_pages(), and released all at once by resetting the arena to a mark.
+ * Regions are kept and reused after a reset, and are only returned to the
+ * firmware by arena_fini().
+ */
+
+#define ARENA_ALIGN		16
+#define ARENA_REGION_SIZE	(64 * 1024)
+
+typedef struct Arena_Region {
+	struct Arena_Region *next;
+	size_t size;
+	size_t used;
+} Arena_Region;
+
+#define ARENA_HEADER_SIZE	ALIGN_UP(sizeof(Arena_Region), ARENA_ALIGN)
+
+/* Regions are linked in order, the ones after gArenaCur are free */
+static Arena_Region *gArenaHead, *gArenaCur;
+
+static Arena_Region *
+arena_new_region(size_t size)
+{
+	size_t regionSize = ALIGN_UP(size + ARENA_HEADER_SIZE,
+				     ARENA_REGION_SIZE);
+
+	memtrack_set_tag("arena");
+	Arena_Region *r = malloc_pages(regionSize);
+	if (!r)
+		panic("Failed to allocate arena");
+
+	*r = (Arena_Region) {
+		.size	= regionSize - ARENA_HEADER_SIZE,
+	};
+
+	return r;
+}
+
+void *
+arena_alloc(size_t size)
+{
+	size = ALIGN_UP(size, ARENA_ALIGN);
+
+	Arena_Region *r = gArenaCur;
+	if (!r || r->size - r->used < size) {
+		/* Move on to the next free region if it fits, or add one */
+		r = gArenaCur ? gArenaCur->next : gArenaHead;
+		if (r && r->size >= size) {
+			r->used = 0;
+		} else {
+			Arena_Region *new = arena_new_region(size);
+
+			new->next = r;
+			if (gArenaCur)
+				gArenaCur->next = new;
+			else
+				gArenaHead = new;
+			r = new;
+		}
+		gArenaCur = r;
+	}
+
+	void *p = (uint8_t *)r + ARENA_HEADER_SIZE + r->used;
+	r->used += size;
+
+	return p;
+}
+
+char *
+arena_strndup(const char *s, size_t len)
+{
+	char *copy = arena_alloc(len + 1);
+	strscpy(copy, s, len + 1);
+	return copy;
+}
+
+Arena_Mark
+arena_mark(void)
+{
+	return (Arena_Mark) {
+		.region	= gArenaCur,
+		.used	= gArenaCur ? gArenaCur->used : 0,
+	};
+}
+
+/*
+ * Release every object allocated from the arena since mark was taken.
+ */
+void
+arena_reset(Arena_Mark mark)
+{
+	gArenaCur = mark.region;
+	if (gArenaCur)
+		gArenaCur->used = mark.used;
+}
+
+/*
+ * Return all regions to the firmware. Nothing allocated from the arena
+ * should be used afterwards.
+ */
+void
+arena_fini(void)
+{
+	while (gArenaHead) {
+		Arena_Region *next = gArenaHead->next;
+		free_pages(gArenaHead, gArenaHead->size + ARENA_HEADER_SIZE);
+		gArenaHead = next;
+	}
+
+	gArenaCur = NULL;
 }
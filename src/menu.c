@@ -10,27 +10,245 @@
 #include <string.h>
 
 #include <extlinux.h>
+#include <file.h>
+#include <menu.h>
 #include <misc.h>
 
+#define MENU_BLS_DIR		"/loader/entries"
+#define MENU_BLS_SUFFIX		".conf"
+
+/*
+ * Load every Boot Loader Specification entry in MENU_BLS_DIR. The directory
+ * is listed with a single read, and all entries are loaded in one batch.
+ */
+static void
+menu_load_bls(Menu *menu)
+{
+	const File_Dir *dir = file_dir_open(MENU_BLS_DIR);
+	if (!dir)
+		return;
+
+	const char *pattern = "*" MENU_BLS_SUFFIX;
+	size_t num = 0;
+	for (const File_Dir_Entry *e = file_dir_match(dir, pattern, NULL);
+	     e;
+	     e = file_dir_match(dir, pattern, e))
+		num += !e->isDir;
+
+	if (!num)
+		return;
+
+	File_Load_Request *files = malloc(sizeof(*files) * num);
+	size_t i = 0;
+	for (const File_Dir_Entry *e = file_dir_match(dir, pattern, NULL);
+	     e;
+	     e = file_dir_match(dir, pattern, e)) {
+		if (e->isDir)
+			continue;
+
+		char *path = malloc(strlen(MENU_BLS_DIR) + strlen(e->name) + 2);
+		strcpy(path, MENU_BLS_DIR "/");
+		strcpy(path + strlen(MENU_BLS_DIR) + 1, e->name);
+
+		/* One more byte to terminate the text */
+		files[i++] = (File_Load_Request) {
+			.path	= path,
+			.type	= FILE_ALLOC_POOL,
+			.extra	= 1,
+		};
+	}
+
+	file_load_batch(files, num);
+
+	for (i = 0; i < num; i++) {
+		if (files[i].size < 0)
+			pr_warn("Can't load %s, ignored\n", files[i].path);
+		else
+			((char *)files[i].buf)[files[i].size] = '\0';
+	}
+
+	menu->blsFiles	= files;
+	menu->blsNum	= num;
+}
+
+/*
+ * Copy value of key from to key to, unless to is already set.
+ */
+static void
+menu_alias(Extlinux_Entry *entry, Extlinux_Key to, Extlinux_Key from)
+{
+	if (!entry->values[to].value)
+		entry->values[to] = entry->values[from];
+}
+
+/*
+ * Translate Boot Loader Specification keys of entry to extlinux ones, which
+ * are accepted in entries of both kinds.
+ */
+static void
+menu_alias_bls_keys(Extlinux_Entry *entry)
+{
+	menu_alias(entry, EXTLINUX_KEY_KERNEL, EXTLINUX_KEY_LINUX);
+	menu_alias(entry, EXTLINUX_KEY_MENU_TITLE, EXTLINUX_KEY_TITLE);
+	menu_alias(entry, EXTLINUX_KEY_APPEND, EXTLINUX_KEY_OPTIONS);
+}
+
+/*
+ * Index the Boot Loader Specification entry file. Its keys are translated to
+ * extlinux ones, and its label is the file name without the suffix.
+ */
+static void
+menu_index_bls(Menu *menu, const File_Load_Request *file)
+{
+	const char *name = file->path + strlen(MENU_BLS_DIR) + 1;
+	Extlinux_Value label = {
+		.value	= name,
+		.len	= strlen(name) - strlen(MENU_BLS_SUFFIX),
+	};
+
+	Extlinux_Entry *entry = extlinux_index_add_entry(&menu->index,
+							 file->buf, &label);
+	if (!entry)
+		return;
+
+	menu_alias_bls_keys(entry);
+
+	/* A broken entry shouldn't take others down */
+	if (!entry->values[EXTLINUX_KEY_KERNEL].value) {
+		pr_warn("No kernel defined in %s, ignored\n", file->path);
+		menu->index.entryNum = entry - menu->index.entries;
+	}
+}
+
+/*
+ * Order of Boot Loader Specification entries, like systemd-boot: those with a
+ * sort key come first, in ascending byte order of it, then newer versions go
+ * before older ones. Versions are compared only if both entries have a sort
+ * key. The rest are ordered by their file names descendingly.
+ */
+static int
+menu_bls_compare(const Extlinux_Entry *a, const Extlinux_Entry *b)
+{
+	const Extlinux_Value *ka = &a->values[EXTLINUX_KEY_SORT_KEY];
+	const Extlinux_Value *kb = &b->values[EXTLINUX_KEY_SORT_KEY];
+
+	if (!ka->value != !kb->value)
+		return ka->value ? -1 : 1;
+
+	if (ka->value) {
+		unsigned long int len = ka->len < kb->len ? ka->len : kb->len;
+		int cmp = memcmp(ka->value, kb->value, len);
+		if (cmp)
+			return cmp;
+
+		if (ka->len != kb->len)
+			return ka->len < kb->len ? -1 : 1;
+
+		const Extlinux_Value *va = &a->values[EXTLINUX_KEY_VERSION];
+		const Extlinux_Value *vb = &b->values[EXTLINUX_KEY_VERSION];
+
+		if (!va->value != !vb->value)
+			return va->value ? -1 : 1;
+
+		cmp = va->value ? extlinux_version_compare(vb, va) : 0;
+		if (cmp)
+			return cmp;
+	}
+
+	return extlinux_version_compare(&b->values[EXTLINUX_KEY_LABEL],
+					&a->values[EXTLINUX_KEY_LABEL]);
+}
+
+/* Insertion sort, there are rarely more than dozens of entries */
+static void
+menu_sort(Extlinux_Entry *entries, size_t num)
+{
+	for (size_t i = 1; i < num; i++) {
+		Extlinux_Entry e = entries[i];
+		size_t j = i;
+
+		for (; j && menu_bls_compare(&entries[j - 1], &e) > 0; j--)
+			entries[j] = entries[j - 1];
+
+		entries[j] = e;
+	}
+}
+
+/*
+ * Index every entry in the parsed configuration pairs, followed by Boot Loader
+ * Specification entries sorted by their versions. Values of pairs must be kept
+ * until menu_free().
+ */
+void
+menu_load(Menu *menu, const Extlinux_Pair *pairs, unsigned long int pairNum)
+{
+	*menu = (Menu) { 0 };
+	menu_load_bls(menu);
+
+	/*
+	 * Entries are known before indexing: each of cfg starts with a label,
+	 * and a drop-in file is indexed as exactly one entry.
+	 */
+	unsigned long int entryMax = menu->blsNum;
+	for (unsigned long int i = 0; i < pairNum; i++)
+		entryMax += pairs[i].key == EXTLINUX_KEY_LABEL;
+
+	Extlinux_Entry *entries = malloc(sizeof(*entries) * entryMax);
+
+	Extlinux_Index *index = &menu->index;
+	extlinux_index_init(index, entries, entryMax);
+	extlinux_index_add_pairs(index, pairs, pairNum);
+
+	unsigned long int cfgNum = index->entryNum;
+	for (unsigned long int i = 0; i < cfgNum && i < entryMax; i++)
+		menu_alias_bls_keys(&entries[i]);
+
+	for (size_t i = 0; i < menu->blsNum; i++) {
+		if (menu->blsFiles[i].size >= 0)
+			menu_index_bls(menu, &menu->blsFiles[i]);
+	}
+
+	/* Entries which didn't fit aren't stored, never expose them */
+	if (index->entryNum > entryMax) {
+		pr_err("Indexed %lu entries, more than %lu expected\n",
+		       index->entryNum, entryMax);
+		index->entryNum = entryMax;
+	}
+
+	menu_sort(entries + cfgNum, index->entryNum - cfgNum);
+}
+
+void
+menu_free(Menu *menu)
+{
+	for (size_t i = 0; i < menu->blsNum; i++) {
+		file_load_release(&menu->blsFiles[i]);
+		free((char *)menu->blsFiles[i].path);
+	}
+
+	free(menu->blsFiles);
+	free(menu->index.entries);
+}
+
+/*
+ * Return a copy of the value of key, allocated from the arena.
+ */
 char *
-menu_get_pair(const char *entry, const char *key)
+menu_get_pair(const Extlinux_Entry *entry, Extlinux_Key key)
 {
-	size_t len = 0;
-	const char *res = extlinux_get_value(entry, key, &len);
+	const Extlinux_Value *v = &entry->values[key];
 
-	if (!res)
+	if (!v->value)
 		return NULL;
 
-	char *copy = malloc(len + 1);
-	strscpy(copy, res, len + 1);
-
-	return copy;
+	return arena_strndup(v->value, v->len);
 }
 
 int
-menu_get_timeout(const char *cfg)
+menu_get_timeout(const Menu *menu)
 {
-	char *res = menu_get_pair(cfg, "timeout");
+	Arena_Mark mark = arena_mark();
+	char *res = menu_get_pair(&menu->index.global, EXTLINUX_KEY_TIMEOUT);
 	if (!res)
 		return 0;
 
@@ -41,19 +259,16 @@ menu_get_timeout(const char *cfg)
 		timeout = 0;
 	}
 
-	free(res);
+	arena_reset(mark);
 
 	return timeout;
 }
 
-const char *
-menu_get_nth_entry(const char *cfg, int index)
+const Extlinux_Entry *
+menu_get_nth_entry(const Menu *menu, int index)
 {
-	const char *entry = extlinux_next_entry(cfg, NULL);
-
-	while (index--)
-		entry = extlinux_next_entry(NULL, entry);
+	if (index < 0 || (unsigned long int)index >= menu->index.entryNum)
+		return NULL;
 
-	return entry;
+	return &menu->index.entries[index];
 }
-
@@ -0,0 +1,222 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/src/placement.c
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#include <efidef.h>
+#include <eficall.h>
+#include <efi.h>
+#include <efiboot.h>
+#include <memory.h>
+
+#include <misc.h>
+#include <placement.h>
+
+#define ALIGN_UP(x, a)		(((x) + (a) - 1) & ~((uint64_t)(a) - 1))
+#define ALIGN_DOWN(x, a)	((x) & ~((uint64_t)(a) - 1))
+
+/* Leave legacy low memory to whoever still cares about it */
+#define PLACEMENT_LOW_MIN	0x100000
+
+/* Allocating the map buffer may split a region, leave room for that */
+#define PLACEMENT_MAP_SLACK	8
+
+typedef struct {
+	Efi_Memory_Descriptor *descs;
+	size_t num;
+	size_t descSize;
+} Placement_Map;
+
+static const char *memoryTypeNames[EFI_MAX_MEMORY_TYPE] = {
+	[EFI_RESERVED_MEMORY_TYPE]		= "reserved",
+	[EFI_LOADER_CODE]			= "loader code",
+	[EFI_LOADER_DATA]			= "loader data",
+	[EFI_BOOT_SERVICES_CODE]		= "boot code",
+	[EFI_BOOT_SERVICES_DATA]		= "boot data",
+	[EFI_RUNTIME_SERVICES_CODE]		= "runtime code",
+	[EFI_RUNTIME_SERVICES_DATA]		= "runtime data",
+	[EFI_CONVENTIONAL_MEMORY]		= "free",
+	[EFI_UNUSABLE_MEMORY]			= "unusable",
+	[EFI_ACPI_RECLAIM_MEMORY]		= "ACPI reclaim",
+	[EFI_ACPI_MEMORY_NVS]			= "ACPI NVS",
+	[EFI_MEMORY_MAPPED_IO]			= "MMIO",
+	[EFI_MEMORY_MAPPED_IO_PORT_SPACE]	= "MMIO port",
+	[EFI_PAL_CODE]				= "PAL code",
+	[EFI_PERSISTENT_MEMORY]			= "persistent",
+	[EFI_UNACCEPTED_MEMORY_TYPE]		= "unaccepted",
+};
+
+/* Free regions are counted in buckets by size for the dump */
+static const uint64_t bucketLimits[] = {
+	0x10000, 0x100000, 0x1000000, 0x10000000,
+};
+static const char *bucketNames[] = {
+	"<64K", "<1M", "<16M", "<256M", ">=256M",
+};
+#define PLACEMENT_BUCKET_NUM	(sizeof(bucketNames) / sizeof(bucketNames[0]))
+
+static Efi_Memory_Descriptor *
+placement_desc(Placement_Map *map, size_t i)
+{
+	return (Efi_Memory_Descriptor *)((uint8_t *)map->descs +
+					 i * map->descSize);
+}
+
+static int
+placement_get_map(Placement_Map *map)
+{
+	uint_native size = 0, key, descSize;
+	uint32_t version;
+	Efi_Status ret;
+
+	map->descs = NULL;
+	while ((ret = efi_call(gBS->getMemoryMap, &size, map->descs, &key,
+			       &descSize, &version)) ==
+	       TO_EFI_ERRNO(EFI_BUFFER_TOO_SMALL)) {
+		free(map->descs);
+		size += PLACEMENT_MAP_SLACK * descSize;
+		map->descs = malloc(size);
+	}
+
+	if (ret != EFI_SUCCESS) {
+		free(map->descs);
+		return -1;
+	}
+
+	map->num	= size / descSize;
+	map->descSize	= descSize;
+
+	return 0;
+}
+
+/*
+ * Search the map for the lowest or highest aligned free range of size bytes,
+ * depending on hint. Return 0 and store its address in addr if found.
+ */
+static int
+placement_find(Placement_Map *map, uint64_t size, size_t align,
+	       Placement_Hint hint, uint64_t *addr)
+{
+	int found = 0;
+
+	for (size_t i = 0; i < map->num; i++) {
+		Efi_Memory_Descriptor *d = placement_desc(map, i);
+		uint64_t start = d->physicalStart;
+		uint64_t end = start + (d->numberOfPages << 12);
+
+		if (d->type != EFI_CONVENTIONAL_MEMORY)
+			continue;
+
+		if (hint == PLACEMENT_LOW && start < PLACEMENT_LOW_MIN)
+			start = PLACEMENT_LOW_MIN;
+
+		if (end <= start || end - start < size)
+			continue;
+
+		uint64_t base = hint == PLACEMENT_HIGH ?
+					ALIGN_DOWN(end - size, align) :
+					ALIGN_UP(start, align);
+		if (base < start || base + size > end)
+			continue;
+
+		if (!found || (hint == PLACEMENT_HIGH ? base > *addr :
+							base < *addr)) {
+			*addr = base;
+			found = 1;
+		}
+	}
+
+	return found ? 0 : -1;
+}
+
+/*
+ * Allocate pages for a large buffer, aligned to align and placed according to
+ * hint: PLACEMENT_HIGH puts it at the top of free memory, out of the way of
+ * the kernel image and its decompression, PLACEMENT_LOW at the lowest aligned
+ * base above legacy memory. The memory map is only a hint, if the range can't
+ * be allocated, the buffer is placed wherever the firmware likes.
+ *
+ * The buffer should be released with free_pages().
+ */
+void *
+placement_alloc(size_t size, size_t align, Placement_Hint hint)
+{
+	Placement_Map map;
+	uint64_t addr = 0;
+	void *p = NULL;
+
+	if (align < 4096)
+		align = 4096;
+
+	if (hint != PLACEMENT_ANY && !placement_get_map(&map)) {
+		if (!placement_find(&map, ALIGN_UP(size, 4096), align, hint,
+				    &addr))
+			p = malloc_pages_at(addr, size);
+		free(map.descs);
+	}
+
+	return p ? p : malloc_pages_aligned(size, align, MEMORY_ADDRESS_ANY);
+}
+
+/*
+ * Print the memory map, followed by a summary of free memory: the largest
+ * free region, how fragmented free memory is, and the number of free regions
+ * by size.
+ */
+void
+placement_dump(void)
+{
+	Placement_Map map;
+
+	if (placement_get_map(&map)) {
+		pr_err("Can't get memory map\n");
+		return;
+	}
+
+	uint64_t freePages = 0, largest = 0;
+	uint64_t buckets[PLACEMENT_BUCKET_NUM] = { 0 };
+	size_t freeNum = 0;
+
+	pr_info("memory map, %lu descriptors\n", map.num);
+
+	for (size_t i = 0; i < map.num; i++) {
+		Efi_Memory_Descriptor *d = placement_desc(&map, i);
+		uint64_t size = d->numberOfPages << 12;
+
+		printf("  0x%lx-0x%lx %s, %lu pages\n",
+		       d->physicalStart, d->physicalStart + size - 1,
+		       d->type < EFI_MAX_MEMORY_TYPE ?
+				memoryTypeNames[d->type] : "unknown",
+		       d->numberOfPages);
+
+		if (d->type != EFI_CONVENTIONAL_MEMORY)
+			continue;
+
+		freeNum++;
+		freePages += d->numberOfPages;
+		if (d->numberOfPages > largest)
+			largest = d->numberOfPages;
+
+		size_t b = 0;
+		while (b < PLACEMENT_BUCKET_NUM - 1 && size >= bucketLimits[b])
+			b++;
+		buckets[b]++;
+	}
+
+	free(map.descs);
+
+	/* Percentage of free memory outside the largest free region */
+	uint64_t fragmentation = freePages ?
+				 100 - largest * 100 / freePages : 0;
+
+	pr_info("free memory %lu MiB in %lu regions, largest %lu MiB, "
+		"fragmentation %lu%%\n",
+		freePages >> 8, freeNum, largest >> 8, fragmentation);
+
+	pr_info("free regions by size:");
+	for (size_t b = 0; b < PLACEMENT_BUCKET_NUM; b++)
+		printf(" %s %lu", bucketNames[b], buckets[b]);
+	printf("\n");
+}
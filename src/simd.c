@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/src/simd.c
+ *	Copyright (c) 2025 Yao Zi.
+ *	The only translation unit built with FP/SIMD registers enabled, see
+ *	SIMD in Makefile.
+ */
+
+#include <efidef.h>
+#include <string.h>
+
+#include <simd.h>
+
+/* Below this size, enabling the vector unit isn't worth it */
+#define SIMD_MIN		(64 * 1024)
+#define SIMD_VECTOR_SIZE	16
+#define SIMD_BLOCK_SIZE		(4 * SIMD_VECTOR_SIZE)
+
+typedef uint8_t Simd_Vector
+	__attribute__((__vector_size__(SIMD_VECTOR_SIZE), __may_alias__));
+typedef uint8_t Simd_Unaligned_Vector
+	__attribute__((__vector_size__(SIMD_VECTOR_SIZE), __may_alias__,
+		       __aligned__(1)));
+
+/*
+ * UEFI enables SSE on x86_64 and FP/SIMD on AArch64 for us, and the compiler
+ * saves callee-saved vector registers it touches. LoongArch only permits the
+ * FP unit after enabling it in CSR.EUEN, where LSX needs to be enabled as
+ * well, thus they're turned on around the vector code and restored after.
+ */
+#ifdef LOLI_TARGET_LOONGARCH64
+
+#define LOONGARCH_CSR_EUEN	0x2
+#define LOONGARCH_EUEN_SIMD	0x3	// FPE | SXE
+
+static uint64_t
+simd_begin(void)
+{
+	uint64_t euen = LOONGARCH_EUEN_SIMD;
+
+	__asm__ volatile ("csrxchg %0, %1, %2"
+			  : "+r" (euen)
+			  : "r" ((uint64_t)LOONGARCH_EUEN_SIMD),
+			    "i" (LOONGARCH_CSR_EUEN)
+			  : "memory");
+
+	return euen;
+}
+
+static void
+simd_end(uint64_t euen)
+{
+	__asm__ volatile ("csrxchg %0, %1, %2"
+			  : "+r" (euen)
+			  : "r" ((uint64_t)LOONGARCH_EUEN_SIMD),
+			    "i" (LOONGARCH_CSR_EUEN)
+			  : "memory");
+}
+
+#else
+
+static uint64_t
+simd_begin(void)
+{
+	return 0;
+}
+
+static void
+simd_end(uint64_t state)
+{
+	(void)state;
+}
+
+#endif
+
+/*
+ * Vector code lives in separate functions, which the compiler can't move
+ * before simd_begin(). Four vectors are loaded before being stored, thus a
+ * copy is also safe for overlapping buffers with dst below src.
+ */
+static __attribute__((noinline)) void
+simd_copy_blocks(uint8_t *d, const uint8_t *s, size_t n)
+{
+	Simd_Vector *dv = (Simd_Vector *)d;
+	const Simd_Unaligned_Vector *sv = (const Simd_Unaligned_Vector *)s;
+
+	for (; n >= SIMD_BLOCK_SIZE; n -= SIMD_BLOCK_SIZE) {
+		Simd_Vector v0 = sv[0], v1 = sv[1], v2 = sv[2], v3 = sv[3];
+
+		dv[0] = v0;
+		dv[1] = v1;
+		dv[2] = v2;
+		dv[3] = v3;
+		dv += 4;
+		sv += 4;
+	}
+}
+
+static __attribute__((noinline)) void
+simd_fill_blocks(uint8_t *d, uint8_t c, size_t n)
+{
+	Simd_Vector *dv = (Simd_Vector *)d;
+	Simd_Vector v = (Simd_Vector) { 0 } + c;
+
+	for (; n >= SIMD_BLOCK_SIZE; n -= SIMD_BLOCK_SIZE) {
+		dv[0] = v;
+		dv[1] = v;
+		dv[2] = v;
+		dv[3] = v;
+		dv += 4;
+	}
+}
+
+/*
+ * The head is copied until dst is aligned to a vector, then whole blocks with
+ * vectors, and the tail with memmove() again, for overlapping buffers.
+ */
+SIMD_ABI void *
+simd_copy(void *dst, const void *src, size_t n)
+{
+	if (n < SIMD_MIN)
+		return memmove(dst, src, n);
+
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+	size_t head = -(uintptr_t)d & (SIMD_VECTOR_SIZE - 1);
+
+	memmove(d, s, head);
+	d += head;
+	s += head;
+	n -= head;
+
+	uint64_t state = simd_begin();
+	simd_copy_blocks(d, s, n);
+	simd_end(state);
+
+	size_t done = n & ~(size_t)(SIMD_BLOCK_SIZE - 1);
+	memmove(d + done, s + done, n - done);
+
+	return dst;
+}
+
+SIMD_ABI void *
+simd_fill(void *dst, int c, size_t n)
+{
+	if (n < SIMD_MIN)
+		return memset(dst, c, n);
+
+	uint8_t *d = dst;
+	size_t head = -(uintptr_t)d & (SIMD_VECTOR_SIZE - 1);
+
+	memset(d, c, head);
+	d += head;
+	n -= head;
+
+	uint64_t state = simd_begin();
+	simd_fill_blocks(d, c, n);
+	simd_end(state);
+
+	size_t done = n & ~(size_t)(SIMD_BLOCK_SIZE - 1);
+	memset(d + done, c, n - done);
+
+	return dst;
+}
@@ -75,6 +75,16 @@ wcscpy(wchar_t *dst, const wchar_t *src)
 	return org;
 }
 
+int
+wcscmp(const wchar_t *s1, const wchar_t *s2)
+{
+	while (*s1 && *s1 == *s2) {
+		s1++;
+		s2++;
+	}
+	return (int)*s1 - (int)*s2;
+}
+
 size_t
 wcs2str(char *str, const wchar_t *wcs)
 {
@@ -199,31 +209,181 @@ vsprintf(char *p, const char *format, va_list va)
 	*p = '\0';
 }
 
+/*
+ * Bulk memory operations move a native word at a time, with general purpose
+ * registers only. Words are accessed through String_Word, which may alias
+ * anything. Architectures handling misaligned loads in hardware also copy by
+ * words when source and destination can't be aligned at the same time.
+ */
+typedef uint_native __attribute__((__may_alias__)) String_Word;
+typedef uint_native __attribute__((__may_alias__, __aligned__(1)))
+	String_Unaligned_Word;
+
+#define STRING_WORD_SIZE	sizeof(String_Word)
+#define STRING_WORD_MASK	(STRING_WORD_SIZE - 1)
+/* Below this size, aligning the pointers costs more than it saves */
+#define STRING_WORD_MIN		(4 * STRING_WORD_SIZE)
+
+#if defined(LOLI_TARGET_X86_64) || defined(LOLI_TARGET_AARCH64) || \
+    defined(LOLI_TARGET_LOONGARCH64)
+#define STRING_UNALIGNED_OK
+#endif
+
+/*
+ * With LOLI_ARCH_STRING defined, memcpy(), memmove(), memset() and memcmp()
+ * come from src/stringops.S instead.
+ */
+#ifndef LOLI_ARCH_STRING
+
+static int
+string_can_copy_words(const void *dst, const void *src, size_t n)
+{
+	if (n < STRING_WORD_MIN)
+		return 0;
+
+#ifdef STRING_UNALIGNED_OK
+	(void)dst;
+	(void)src;
+	return 1;
+#else
+	return !(((uintptr_t)dst ^ (uintptr_t)src) & STRING_WORD_MASK);
+#endif
+}
+
+/*
+ * Copy from the lowest address upwards, which is also safe for overlapping
+ * buffers as long as dst is below src.
+ */
+static void
+copy_forward(uint8_t *d, const uint8_t *s, size_t n)
+{
+	if (string_can_copy_words(d, s, n)) {
+		while ((uintptr_t)d & STRING_WORD_MASK) {
+			*(d++) = *(s++);
+			n--;
+		}
+
+		String_Word *dw = (String_Word *)d;
+		const String_Unaligned_Word *sw =
+			(const String_Unaligned_Word *)s;
+
+		for (; n >= 4 * STRING_WORD_SIZE; n -= 4 * STRING_WORD_SIZE) {
+			dw[0] = sw[0];
+			dw[1] = sw[1];
+			dw[2] = sw[2];
+			dw[3] = sw[3];
+			dw += 4;
+			sw += 4;
+		}
+
+		for (; n >= STRING_WORD_SIZE; n -= STRING_WORD_SIZE)
+			*(dw++) = *(sw++);
+
+		d = (uint8_t *)dw;
+		s = (const uint8_t *)sw;
+	}
+
+	while (n--)
+		*(d++) = *(s++);
+}
+
+/*
+ * Copy from the highest address downwards, for overlapping buffers where dst
+ * is above src.
+ */
+static void
+copy_backward(uint8_t *d, const uint8_t *s, size_t n)
+{
+	d += n;
+	s += n;
+
+	if (string_can_copy_words(d, s, n)) {
+		while ((uintptr_t)d & STRING_WORD_MASK) {
+			*(--d) = *(--s);
+			n--;
+		}
+
+		String_Word *dw = (String_Word *)d;
+		const String_Unaligned_Word *sw =
+			(const String_Unaligned_Word *)s;
+
+		for (; n >= 4 * STRING_WORD_SIZE; n -= 4 * STRING_WORD_SIZE) {
+			dw -= 4;
+			sw -= 4;
+			dw[3] = sw[3];
+			dw[2] = sw[2];
+			dw[1] = sw[1];
+			dw[0] = sw[0];
+		}
+
+		for (; n >= STRING_WORD_SIZE; n -= STRING_WORD_SIZE)
+			*(--dw) = *(--sw);
+
+		d = (uint8_t *)dw;
+		s = (const uint8_t *)sw;
+	}
+
+	while (n--)
+		*(--d) = *(--s);
+}
+
 void *
 memcpy(void *dst, const void *src, size_t n)
 {
-	const char *pSrc = src;
-	char *pDst = dst;
-	while (n--)
-		*(pDst++) = *(pSrc++);
+	copy_forward(dst, src, n);
 	return dst;
 }
 
 void *
 memmove(void *dst, const void *src, size_t n)
 {
-	return memcpy(dst, src, n);
+	uint8_t *d = dst;
+	const uint8_t *s = src;
+
+	if (d <= s || d >= s + n)
+		copy_forward(d, s, n);
+	else
+		copy_backward(d, s, n);
+
+	return dst;
 }
 
 void *
 memset(void *mem, int c, size_t n)
 {
-	char *p = mem;
+	uint8_t *p = mem;
+
+	if (n >= STRING_WORD_MIN) {
+		String_Word pattern = (uint8_t)c * (~(String_Word)0 / 0xff);
+
+		while ((uintptr_t)p & STRING_WORD_MASK) {
+			*(p++) = c;
+			n--;
+		}
+
+		String_Word *pw = (String_Word *)p;
+		for (; n >= 4 * STRING_WORD_SIZE; n -= 4 * STRING_WORD_SIZE) {
+			pw[0] = pattern;
+			pw[1] = pattern;
+			pw[2] = pattern;
+			pw[3] = pattern;
+			pw += 4;
+		}
+
+		for (; n >= STRING_WORD_SIZE; n -= STRING_WORD_SIZE)
+			*(pw++) = pattern;
+
+		p = (uint8_t *)pw;
+	}
+
 	while (n--)
 		*(p++) = c;
+
 	return mem;
 }
 
+#endif	// LOLI_ARCH_STRING
+
 int
 atou(const char *s)
 {
@@ -260,18 +420,36 @@ strscpy(char *dst, const char *src, size_t dstlen)
 	return n;
 }
 
+#ifndef LOLI_ARCH_STRING
+
 int
-memcmp(void *a, void *b, size_t len)
+memcmp(const void *a, const void *b, size_t len)
 {
-	char *c = a, *d = b;
+	const uint8_t *c = a, *d = b;
+
+	/* Skip the common prefix by words, then find the difference by bytes */
+#ifndef STRING_UNALIGNED_OK
+	if (!(((uintptr_t)c | (uintptr_t)d) & STRING_WORD_MASK))
+#endif
+	{
+		while (len >= STRING_WORD_SIZE &&
+		       *(const String_Unaligned_Word *)c ==
+		       *(const String_Unaligned_Word *)d) {
+			c	+= STRING_WORD_SIZE;
+			d	+= STRING_WORD_SIZE;
+			len	-= STRING_WORD_SIZE;
+		}
+	}
+
 	while (len--) {
 		if (*c != *d)
 			return *c - *d;
 
 		c++;
 		d++;
-		len--;
 	}
 
 	return 0;
 }
+
+#endif	// LOLI_ARCH_STRING
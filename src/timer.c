@@ -0,0 +1,86 @@
+// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/src/timer.c
+ *	Copyright (c) 2025 Yao Zi.
+ */
+
+#include <efidef.h>
+#include <eficall.h>
+#include <efi.h>
+#include <efiboot.h>
+#include <timer.h>
+
+#define TIMER_CALIBRATION_US	1000
+
+static uint64_t gFrequency;
+
+/*
+ * Read the free-running counter of the architecture, which is the TSC on
+ * x86_64, and the time CSR (or its equivalence) on the others.
+ */
+uint64_t
+timer_read(void)
+{
+	uint64_t t;
+
+#if defined(LOLI_TARGET_X86_64)
+	uint32_t lo, hi;
+	__asm__ volatile ("rdtsc" : "=a" (lo), "=d" (hi));
+	t = ((uint64_t)hi << 32) | lo;
+#elif defined(LOLI_TARGET_AARCH64)
+	__asm__ volatile ("isb; mrs %0, cntvct_el0" : "=r" (t) :: "memory");
+#elif defined(LOLI_TARGET_RISCV64)
+	__asm__ volatile ("rdtime %0" : "=r" (t));
+#elif defined(LOLI_TARGET_LOONGARCH64)
+	__asm__ volatile ("rdtime.d %0, $zero" : "=r" (t));
+#endif
+
+	return t;
+}
+
+/*
+ * Return ticks per second of timer_read(). Only AArch64 tells the frequency
+ * architecturally, on other architectures it's measured against Stall() once.
+ */
+uint64_t
+timer_frequency(void)
+{
+	if (gFrequency)
+		return gFrequency;
+
+#if defined(LOLI_TARGET_AARCH64)
+	__asm__ volatile ("mrs %0, cntfrq_el0" : "=r" (gFrequency));
+#else
+	uint64_t start = timer_read();
+	efi_call(gBS->stall, TIMER_CALIBRATION_US);
+	gFrequency = (timer_read() - start) * (1000000 / TIMER_CALIBRATION_US);
+#endif
+
+	/* Avoid dividing by zero on broken firmware */
+	if (!gFrequency)
+		gFrequency = 1;
+
+	return gFrequency;
+}
+
+static uint64_t
+timer_convert(uint64_t ticks, uint64_t unitsPerSecond)
+{
+	uint64_t freq = timer_frequency();
+
+	return ticks / freq * unitsPerSecond +
+	       ticks % freq * unitsPerSecond / freq;
+}
+
+uint64_t
+timer_to_us(uint64_t ticks)
+{
+	return timer_convert(ticks, 1000000);
+}
+
+uint64_t
+timer_to_ns(uint64_t ticks)
+{
+	return timer_convert(ticks, 1000000000);
+}
@@ -68,6 +68,23 @@ label Linux 6.12
 			{ next, "Linux 6.6" },
 			{ get, "kernel", "/Image-6.6" },
 		},
+		index	= {
+			global	= { timeout = "10" },
+			entries	= {
+				{
+					label	= "Linux 6.6",
+					kernel	= "/Image-6.6",
+					initrd	= "/initramfs-6.6.img",
+					append	= "console=tty0 quiet",
+				},
+				{
+					label	= "Linux 6.12",
+					kernel	= "/Image-6.12",
+					initrd	= "/initramfs-6.12.img",
+					append	= "console=tty0 quiet",
+				},
+			},
+		},
 	},
 	{
 		name	= "no entries",
@@ -81,6 +98,10 @@ default 1
 			{ get, "default", "1" },
 			{ next, nil },
 		},
+		index	= {
+			global	= { timeout = "10", default = "1" },
+			entries	= {},
+		},
 	},
 	{
 		name	= "no global options",
@@ -99,6 +120,13 @@ label test2
 			{ get, "kernel", "image2" },
 			{ next, nil },
 		},
+		index	= {
+			global	= {},
+			entries	= {
+				{ label = "test1", kernel = "image1" },
+				{ label = "test2", kernel = "image2" },
+			},
+		},
 	},
 	{
 		--[[
@@ -196,6 +224,66 @@ kernel a
 			{ get, "kernel", "a" },
 			{ next, nil },
 		},
+		index	= {
+			global	= {},
+			entries	= {
+				{
+					label		= "a b",
+					kernel		= "b",
+					["menu title"]	= "this is a titleqwq",
+					initrd		= "/kernel",
+				},
+				{ label = "b", kernel = "a" },
+			},
+		},
+	},
+	{
+		name	= "Repeated keys",
+		conf	= [[
+timeout 1
+timeout 2
+label a
+	kernel first  
+	kernel second
+	menu  title	spaced title
+]],
+		opts	= {
+			{ get, "timeout", "1" },
+			{ next, "a" },
+			{ get, "kernel", "first" },
+			{ next, nil },
+		},
+		index	= {
+			global	= { timeout = "1" },
+			entries	= {
+				{
+					label		= "a",
+					kernel		= "first",
+					["menu title"]	= "spaced title",
+				},
+			},
+		},
+	},
+	{
+		name	= "Include directives",
+		conf	= [[
+include /common.cfg
+label a
+	include /board.cfg
+	include /other.cfg
+]],
+		opts	= {
+			{ get, "include", "/common.cfg" },
+			{ next, "a" },
+			{ get, "include", "/board.cfg" },
+			{ next, nil },
+		},
+		index	= {
+			global	= { include = "/common.cfg" },
+			entries	= {
+				{ label = "a", include = "/board.cfg" },
+			},
+		},
 	},
 	{
 		name	= "Keys with trailing spaces",
@@ -213,19 +301,159 @@ kernel b
 };
 
 local function
-runCase(conf, opts)
+checkPairs(what, got, expect)
+	for k, v in pairs(expect) do
+		assert(got[k] == v,
+		       ("%s: expect %q for %q, got %q"):format(what, v, k,
+							       got[k]));
+	end
+	for k, v in pairs(got) do
+		assert(expect[k], ("%s: unexpected %q = %q"):format(what, k, v));
+	end
+end
+
+local function
+checkIndex(conf, index)
+	for _, parsed in ipairs { false, true } do
+		verbose(("check index, parsed = %s"):format(parsed));
+
+		local global, entries = extlinux.index(conf, parsed);
+
+		checkPairs("global", global, index.global);
+		assert(#entries == #index.entries,
+		       ("expect %d entries, got %d"):format(#index.entries,
+							    #entries));
+		for i, entry in ipairs(index.entries) do
+			checkPairs(("entry %d"):format(i), entries[i], entry);
+		end
+	end
+end
+
+local function
+runCase(conf, opts, index)
 	local iter = conf;
 
 	for _, opt in ipairs(opts) do
 		iter = opt[1](iter, table.unpack(opt));
 	end
+
+	if index then
+		checkIndex(conf, index);
+	end
 end
 
+--[[
+--	Drop-in files, like Boot Loader Specification entries, each indexed as
+--	exactly one entry labeled with the file name
+--]]
+local dropins = {
+	{
+		name	= "drop-in entry",
+		label	= "linux-6.12",
+		conf	= [[
+title Linux 6.12
+version 6.12
+linux /vmlinuz-6.12
+initrd /initramfs-6.12.img
+options root=/dev/sda1
+]],
+		entry	= {
+			label		= "linux-6.12",
+			title		= "Linux 6.12",
+			version		= "6.12",
+			linux		= "/vmlinuz-6.12",
+			initrd		= "/initramfs-6.12.img",
+			options		= "root=/dev/sda1",
+		},
+	},
+	{
+		name	= "label keys in a drop-in file",
+		label	= "linux",
+		conf	= [[
+label first
+linux /vmlinuz
+label second
+	initrd /initrd
+]],
+		entry	= {
+			label	= "linux",
+			linux	= "/vmlinuz",
+			initrd	= "/initrd",
+		},
+	},
+	{
+		name	= "empty drop-in file",
+		label	= "empty",
+		conf	= "",
+		entry	= { label = "empty" },
+	},
+};
+
+--[[
+--	Version pairs and how the first compares to the second, following the
+--	UAPI Version Format Specification
+--]]
+local versions = {
+	{ "6.1", "6.1", 0 },
+	{ "6.12", "6.6", 1 },
+	{ "1.10", "1.9", 1 },
+	{ "01", "1", 0 },
+	{ "1.0", "1.0.1", -1 },
+	{ "abc", "abd", -1 },
+	{ "ab", "abc", -1 },
+
+	-- '~' sorts before everything, even the end of the version
+	{ "6.1~rc1", "6.1", -1 },
+	{ "6.1", "6.1~rc1", 1 },
+	{ "6.1~rc1", "6.1~rc2", -1 },
+	{ "6.1~rc1", "6.1-1", -1 },
+	{ "~", "", -1 },
+
+	-- '-', '^' and '.' are separators, which sort in order before others
+	{ "123-4", "123.1", -1 },
+	{ "1.0^", "1.0", 1 },
+	{ "1.0^", "1.0.1", -1 },
+	{ "1-2", "1^2", -1 },
+	{ "1.a", "1a", -1 },
+
+	-- Other non-alphanumeric characters are skipped, but still separate runs
+	{ "1_a", "1a", 0 },
+	{ "1_0", "10", -1 },
+	{ "6.1+foo", "6.1foo", 0 },
+
+	-- Letters sort before digits
+	{ "a", "1", -1 },
+	{ "1.0a", "1.01", -1 },
+	{ "1.0a", "1.0", 1 },
+};
+
 for i, case in ipairs(cases) do
 	io.stdout:write(("case %d: %s "):format(i, case.name));
 	io.stdout:flush();
 
-	runCase(case.conf, case.opts);
+	runCase(case.conf, case.opts, case.index);
+
+	io.stdout:write("[OK]\n");
+end
+
+for _, dropin in ipairs(dropins) do
+	io.stdout:write(("drop-in: %s "):format(dropin.name));
+	io.stdout:flush();
+
+	local global, entries = extlinux.entry(dropin.conf, dropin.label);
+	checkPairs("global", global, {});
+	assert(#entries == 1, ("expect 1 entry, got %d"):format(#entries));
+	checkPairs("entry", entries[1], dropin.entry);
+
+	io.stdout:write("[OK]\n");
+end
+
+for _, v in ipairs(versions) do
+	io.stdout:write(("version %q vs %q "):format(v[1], v[2]));
+	io.stdout:flush();
+
+	local got = extlinux.vercmp(v[1], v[2]);
+	assert(got == v[3], ("expect %d, got %d"):format(v[3], got));
 
 	io.stdout:write("[OK]\n");
 end
@@ -0,0 +1,245 @@
+/*
+ *	loli-loader testsuite
+ *	/tests/extlinuxbench.c
+ *	Throughput of extlinux.c over generated configurations
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "extlinux.h"
+
+/* Lookups to time per configuration */
+#define BENCH_LOOKUPS		200000
+/* Bytes of white space in the "deep whitespace" configurations */
+#define BENCH_SPACE_DEPTH	256
+#define BENCH_APPEND_LEN	4096
+
+typedef struct {
+	char *buf;
+	size_t size, capacity;
+} Conf;
+
+typedef struct {
+	const char *name;
+	void (*generate)(Conf *conf, unsigned long int entries);
+	const unsigned long int *entryNums;
+} Scenario;
+
+static void
+conf_add(Conf *conf, const char *s)
+{
+	size_t len = strlen(s);
+
+	if (conf->size + len + 1 > conf->capacity) {
+		conf->capacity = (conf->capacity + len + 1) * 2;
+		conf->buf = realloc(conf->buf, conf->capacity);
+		if (!conf->buf) {
+			fputs("can't allocate configuration\n", stderr);
+			exit(1);
+		}
+	}
+
+	memcpy(conf->buf + conf->size, s, len + 1);
+	conf->size += len;
+}
+
+static void
+conf_add_entry(Conf *conf, unsigned long int i, const char *indent,
+	       const char *sep, const char *append)
+{
+	char line[4 * BENCH_SPACE_DEPTH];
+
+	snprintf(line, sizeof(line), "%slabel%sLinux %lu\n", indent, sep, i);
+	conf_add(conf, line);
+	snprintf(line, sizeof(line), "%smenu%stitle%sLinux snapshot %lu\n",
+		 indent, sep, sep, i);
+	conf_add(conf, line);
+	snprintf(line, sizeof(line), "%skernel%s/vmlinuz-%lu\n",
+		 indent, sep, i);
+	conf_add(conf, line);
+	snprintf(line, sizeof(line), "%sinitrd%s/initramfs-%lu.img\n",
+		 indent, sep, i);
+	conf_add(conf, line);
+	snprintf(line, sizeof(line), "%sfdt%s/dtbs/%lu/board.dtb\n",
+		 indent, sep, i);
+	conf_add(conf, line);
+
+	snprintf(line, sizeof(line), "%sappend%s", indent, sep);
+	conf_add(conf, line);
+	conf_add(conf, append);
+	conf_add(conf, "\n");
+}
+
+static void
+generate_plain(Conf *conf, unsigned long int entries)
+{
+	conf_add(conf, "timeout 10\ndefault Linux 0\n");
+
+	for (unsigned long int i = 0; i < entries; i++)
+		conf_add_entry(conf, i, "\t", " ", "root=/dev/sda2 rw quiet");
+}
+
+static void
+generate_long_append(Conf *conf, unsigned long int entries)
+{
+	char append[BENCH_APPEND_LEN + 1];
+
+	for (int i = 0; i < BENCH_APPEND_LEN; i++)
+		append[i] = i % 16 == 15 ? ' ' : 'a' + i % 26;
+	append[BENCH_APPEND_LEN] = '\0';
+
+	conf_add(conf, "timeout 10\n");
+	for (unsigned long int i = 0; i < entries; i++)
+		conf_add_entry(conf, i, "\t", " ", append);
+}
+
+static void
+generate_deep_space(Conf *conf, unsigned long int entries)
+{
+	char space[BENCH_SPACE_DEPTH + 1];
+
+	for (int i = 0; i < BENCH_SPACE_DEPTH; i++)
+		space[i] = i % 2 ? ' ' : '\t';
+	space[BENCH_SPACE_DEPTH] = '\0';
+
+	conf_add(conf, space);
+	conf_add(conf, "timeout");
+	conf_add(conf, space);
+	conf_add(conf, "10\n");
+	for (unsigned long int i = 0; i < entries; i++)
+		conf_add_entry(conf, i, space, space, "quiet");
+}
+
+/* Lines which resemble known keys but never match any */
+static const char *nearMatches[] = {
+	"labe Linux\n",		"labell Linux\n",	"label\n",
+	"kernel\n",		"kernel\t \n",		"kernelx /vmlinuz\n",
+	"menu titl x\n",	"menu\n",		"menutitle x\n",
+	"Label x\n",		"fdtdir /dtbs\n",	"initrd_ /boot\n",
+	"appendix quiet\n",	"l a b e l\n",		"default\n",
+};
+#define NEAR_MATCH_NUM	(sizeof(nearMatches) / sizeof(nearMatches[0]))
+
+static void
+generate_near_matches(Conf *conf, unsigned long int entries)
+{
+	conf_add(conf, "timeout 10\n");
+	for (unsigned long int i = 0; i < entries; i++) {
+		for (unsigned long int j = 0; j < NEAR_MATCH_NUM; j++)
+			conf_add(conf, nearMatches[(i + j) % NEAR_MATCH_NUM]);
+		conf_add_entry(conf, i, "", " ", "quiet");
+	}
+}
+
+static const unsigned long int manyEntries[] = {
+	10, 100, 1000, 10000, 100000, 0,
+};
+static const unsigned long int fewEntries[] = {
+	10, 100, 1000, 0,
+};
+
+static const Scenario scenarios[] = {
+	{ "plain",		generate_plain,		manyEntries },
+	{ "long append",	generate_long_append,	fewEntries },
+	{ "deep whitespace",	generate_deep_space,	fewEntries },
+	{ "near matches",	generate_near_matches,	manyEntries },
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static unsigned long int
+count_lines(const char *p)
+{
+	unsigned long int lines = 0;
+
+	while ((p = strchr(p, '\n'))) {
+		p++;
+		lines++;
+	}
+
+	return lines;
+}
+
+static void
+run(const Scenario *s, unsigned long int entryNum)
+{
+	Conf conf = { NULL, 0, 0 };
+
+	s->generate(&conf, entryNum);
+	unsigned long int lines = count_lines(conf.buf);
+
+	/* Walk through all entries, as the menu did before indexing */
+	double start = now();
+	const char **entries = malloc(sizeof(*entries) * entryNum);
+	unsigned long int found = 0;
+	for (const char *p = extlinux_next_entry(conf.buf, NULL);
+	     p;
+	     p = extlinux_next_entry(NULL, p))
+		entries[found++] = p;
+	double walk = (now() - start) / lines;
+
+	if (found != entryNum) {
+		fprintf(stderr, "%s: expect %lu entries, found %lu\n",
+			s->name, entryNum, found);
+		exit(1);
+	}
+
+	Extlinux_Entry *indexed = malloc(sizeof(*indexed) * entryNum);
+	Extlinux_Index index;
+	start = now();
+	extlinux_index_init(&index, indexed, entryNum);
+	extlinux_index_add(&index, conf.buf);
+	double indexing = (now() - start) / lines;
+
+	static const char *keys[] = {
+		"kernel", "initrd", "append", "menu title", "devicetree",
+	};
+	unsigned long int sum = 0, len;
+	srand(entryNum);
+	start = now();
+	for (int i = 0; i < BENCH_LOOKUPS; i++) {
+		const char *v = extlinux_get_value(entries[rand() % entryNum],
+						   keys[i % 5], &len);
+		sum += v ? len : 0;
+	}
+	double lookup = (now() - start) / BENCH_LOOKUPS;
+
+	printf("%-16s %8lu %9lu %10.2f %10.2f %10.2f\n", s->name, entryNum,
+	       lines, walk, indexing, lookup);
+	fflush(stdout);
+
+	/* Keep the lookups from being optimized out */
+	if (!sum)
+		fputs("no values found\n", stderr);
+
+	free(indexed);
+	free(entries);
+	free(conf.buf);
+}
+
+int
+main(void)
+{
+	printf("%-16s %8s %9s %10s %10s %10s\n", "config", "entries", "lines",
+	       "walk ns/l", "index ns/l", "get ns");
+
+	for (size_t i = 0; i < sizeof(scenarios) / sizeof(scenarios[0]); i++) {
+		for (const unsigned long int *n = scenarios[i].entryNums;
+		     *n; n++)
+			run(&scenarios[i], *n);
+	}
+
+	return 0;
+}
@@ -0,0 +1,7 @@
+set -e
+
+cc extlinuxbench.c ../src/extlinux.c -o extlinuxbench -O2 \
+	-iquote../include \
+	-Wall -Werror -pedantic -Wextra
+./extlinuxbench
+rm -f extlinuxbench
@@ -0,0 +1,185 @@
+/*
+ *	loli-loader testsuite
+ *	/tests/extlinuxfuzz.c
+ *	libFuzzer target for extlinux.c
+ *
+ *	Besides memory safety, the index is checked against lookups of every
+ *	key with extlinux_next_entry() and extlinux_get_value(), and against
+ *	an index built from pairs of extlinux_parse(). The input is indexed as
+ *	a drop-in entry with extlinux_index_add_entry() as well, which should
+ *	take the first pair of every key but "label".
+ *
+ *	Built without libFuzzer (EXTLINUX_FUZZ_MAIN defined), the inputs given
+ *	as arguments are run once, for reproducing findings.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "extlinux.h"
+
+#define FUZZ_ENTRY_MAX	64
+#define FUZZ_PAIR_MAX	1024
+
+static void
+check_value(const char *where, const Extlinux_Value *indexed,
+	    const char *value, unsigned long int len)
+{
+	if (indexed->value == value && (!value || indexed->len == len))
+		return;
+
+	fprintf(stderr, "%s: index and lookup disagree\n", where);
+	abort();
+}
+
+static void
+check_pairs(const char *conf, const Extlinux_Index *index)
+{
+	static Extlinux_Pair pairs[FUZZ_PAIR_MAX];
+	unsigned long int num = extlinux_parse(conf, pairs, FUZZ_PAIR_MAX);
+
+	/* Pairs which don't fit aren't stored */
+	if (num > FUZZ_PAIR_MAX)
+		return;
+
+	Extlinux_Entry entries[FUZZ_ENTRY_MAX];
+	Extlinux_Index parsed;
+	extlinux_index_init(&parsed, entries, FUZZ_ENTRY_MAX);
+	extlinux_index_add_pairs(&parsed, pairs, num);
+
+	unsigned long int n = parsed.entryNum < FUZZ_ENTRY_MAX ?
+				parsed.entryNum : FUZZ_ENTRY_MAX;
+	if (parsed.entryNum != index->entryNum ||
+	    memcmp(&parsed.global, &index->global, sizeof(parsed.global)) ||
+	    memcmp(entries, index->entries, sizeof(*entries) * n)) {
+		fputs("index of parsed pairs differs\n", stderr);
+		abort();
+	}
+}
+
+static void
+check_entry(const char *conf)
+{
+	static Extlinux_Pair pairs[FUZZ_PAIR_MAX];
+	unsigned long int num = extlinux_parse(conf, pairs, FUZZ_PAIR_MAX);
+
+	Extlinux_Value label = { .value = "drop-in", .len = 7 };
+	Extlinux_Entry entries[1];
+	Extlinux_Index index;
+	extlinux_index_init(&index, entries, 1);
+
+	Extlinux_Entry *entry = extlinux_index_add_entry(&index, conf, &label);
+	if (entry != &entries[0] || index.entryNum != 1) {
+		fputs("drop-in isn't indexed as exactly one entry\n", stderr);
+		abort();
+	}
+
+	if (num <= FUZZ_PAIR_MAX) {
+		Extlinux_Entry expect = { 0 };
+		expect.values[EXTLINUX_KEY_LABEL] = label;
+
+		for (unsigned long int i = 0; i < num; i++) {
+			Extlinux_Value *v = &expect.values[pairs[i].key];
+			if (!v->value)
+				*v = pairs[i].value;
+		}
+
+		if (memcmp(&expect, entry, sizeof(expect))) {
+			fputs("drop-in entry differs from parsed pairs\n",
+			      stderr);
+			abort();
+		}
+	}
+
+	/* The index is full, an entry more must not be stored */
+	if (extlinux_index_add_entry(&index, conf, &label) ||
+	    index.entryNum != 2) {
+		fputs("drop-in is stored beyond the index\n", stderr);
+		abort();
+	}
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	/* The parser works on NUL-terminated strings */
+	char *conf = malloc(size + 1);
+	memcpy(conf, data, size);
+	conf[size] = '\0';
+
+	Extlinux_Entry entries[FUZZ_ENTRY_MAX];
+	Extlinux_Index index;
+	extlinux_index_init(&index, entries, FUZZ_ENTRY_MAX);
+	extlinux_index_add(&index, conf);
+	check_pairs(conf, &index);
+	check_entry(conf);
+
+	const char *first = extlinux_next_entry(conf, NULL);
+	unsigned long int len = 0;
+
+	/*
+	 * Looking up global options in a configuration starting with a label
+	 * scans the first entry instead, skip the check then.
+	 */
+	if (first != conf) {
+		for (int key = 0; key < EXTLINUX_KEY_NUM; key++) {
+			if (key == EXTLINUX_KEY_LABEL)
+				continue;
+
+			const char *v = extlinux_get_value(conf,
+						extlinux_key_name(key), &len);
+			check_value("global", &index.global.values[key], v,
+				    len);
+		}
+	}
+
+	unsigned long int n = 0;
+	for (const char *p = first; p; p = extlinux_next_entry(NULL, p), n++) {
+		if (n >= FUZZ_ENTRY_MAX)
+			continue;
+
+		for (int key = 0; key < EXTLINUX_KEY_NUM; key++) {
+			const char *v = extlinux_get_value(p,
+						extlinux_key_name(key), &len);
+			check_value("entry", &entries[n].values[key], v, len);
+		}
+	}
+
+	if (n != index.entryNum) {
+		fprintf(stderr, "found %lu entries, indexed %lu\n",
+			n, index.entryNum);
+		abort();
+	}
+
+	free(conf);
+	return 0;
+}
+
+#ifdef EXTLINUX_FUZZ_MAIN
+
+int
+main(int argc, const char *argv[])
+{
+	for (int i = 1; i < argc; i++) {
+		FILE *fp = fopen(argv[i], "rb");
+		if (!fp) {
+			perror(argv[i]);
+			return 1;
+		}
+
+		static uint8_t buf[1 << 20];
+		size_t size = fread(buf, 1, sizeof(buf), fp);
+		fclose(fp);
+
+		LLVMFuzzerTestOneInput(buf, size);
+		printf("%s: OK\n", argv[i]);
+	}
+
+	return 0;
+}
+
+#endif
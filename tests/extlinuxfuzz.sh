@@ -0,0 +1,12 @@
+set -e
+
+# libFuzzer comes with Clang. Arguments are passed to the fuzzer, a corpus is
+# kept in fuzz-corpus/ and FUZZ_TIME limits the run in seconds.
+FUZZCC=${FUZZCC:-clang}
+
+$FUZZCC extlinuxfuzz.c ../src/extlinux.c -o extlinuxfuzz -g -O1 \
+	-fsanitize=fuzzer,address,undefined \
+	-iquote../include \
+	-Wall -Werror -pedantic -Wextra
+mkdir -p fuzz-corpus
+./extlinuxfuzz -max_total_time=${FUZZ_TIME:-60} "$@" fuzz-corpus
@@ -53,9 +53,133 @@ lextlinux_get(lua_State *l)
 	return value ? 1 : 0;
 }
 
+static void
+push_entry(lua_State *l, const Extlinux_Entry *entry)
+{
+	lua_newtable(l);
+
+	for (int key = 0; key < EXTLINUX_KEY_NUM; key++) {
+		const Extlinux_Value *v = &entry->values[key];
+
+		if (!v->value)
+			continue;
+
+		lua_pushlstring(l, v->value, v->len);
+		lua_setfield(l, -2, extlinux_key_name(key));
+	}
+}
+
+static void
+index_conf(Extlinux_Index *index, const char *conf,
+	   const Extlinux_Pair *pairs, unsigned long int pairNum)
+{
+	if (pairs)
+		extlinux_index_add_pairs(index, pairs, pairNum);
+	else
+		extlinux_index_add(index, conf);
+}
+
+/*
+ * Return the global options and an array of entries of the configuration,
+ * both as tables of key-value pairs. The configuration is indexed from pairs
+ * of extlinux_parse() if the second argument is true.
+ */
+static int
+lextlinux_index(lua_State *l)
+{
+	const char *conf = luaL_checkstring(l, 1);
+	Extlinux_Pair *pairs = NULL;
+	unsigned long int pairNum = 0;
+	Extlinux_Index index;
+
+	if (lua_toboolean(l, 2)) {
+		pairNum = extlinux_parse(conf, NULL, 0);
+		pairs = lua_newuserdatauv(l, sizeof(*pairs) * pairNum, 0);
+		extlinux_parse(conf, pairs, pairNum);
+	}
+
+	/* Count the entries first */
+	extlinux_index_init(&index, NULL, 0);
+	index_conf(&index, conf, pairs, pairNum);
+
+	unsigned long int entryNum = index.entryNum;
+	Extlinux_Entry *entries = lua_newuserdatauv(l,
+					sizeof(*entries) * entryNum, 0);
+	extlinux_index_init(&index, entries, entryNum);
+	index_conf(&index, conf, pairs, pairNum);
+
+	push_entry(l, &index.global);
+
+	lua_newtable(l);
+	for (unsigned long int i = 0; i < entryNum; i++) {
+		push_entry(l, &entries[i]);
+		lua_rawseti(l, -2, i + 1);
+	}
+
+	return 2;
+}
+
+/*
+ * Index a drop-in file as exactly one entry labeled with the second argument,
+ * return the global options and the array of entries like index().
+ */
+static int
+lextlinux_entry(lua_State *l)
+{
+	const char *conf = luaL_checkstring(l, 1);
+	Extlinux_Value label;
+	size_t len;
+
+	label.value	= luaL_checklstring(l, 2, &len);
+	label.len	= len;
+
+	/* Leave room for an extra entry, which shouldn't be there */
+	Extlinux_Entry entries[2];
+	Extlinux_Index index;
+	extlinux_index_init(&index, entries, 2);
+
+	Extlinux_Entry *entry = extlinux_index_add_entry(&index, conf, &label);
+	if (entry != &entries[0])
+		return luaL_error(l, "entry is stored at the wrong place");
+
+	push_entry(l, &index.global);
+
+	lua_newtable(l);
+	for (unsigned long int i = 0; i < index.entryNum && i < 2; i++) {
+		push_entry(l, &entries[i]);
+		lua_rawseti(l, -2, i + 1);
+	}
+
+	return 2;
+}
+
+/*
+ * Compare two versions, return -1, 0 or 1 if the first one is older than,
+ * equal to or newer than the second one.
+ */
+static int
+lextlinux_vercmp(lua_State *l)
+{
+	Extlinux_Value a, b;
+	size_t len;
+
+	a.value	= luaL_checklstring(l, 1, &len);
+	a.len	= len;
+	b.value	= luaL_checklstring(l, 2, &len);
+	b.len	= len;
+
+	int cmp = extlinux_version_compare(&a, &b);
+	lua_pushinteger(l, cmp < 0 ? -1 : cmp > 0);
+
+	return 1;
+}
+
 static const luaL_Reg extlinux_funcs[] = {
 	{ "next", lextlinux_next },
 	{ "get", lextlinux_get },
+	{ "index", lextlinux_index },
+	{ "entry", lextlinux_entry },
+	{ "vercmp", lextlinux_vercmp },
 	{ NULL, NULL },
 };
 
@@ -0,0 +1,15 @@
+/*
+ *	loli-loader testsuite
+ *	/tests/strbench-loli.c
+ *	src/string.c built for the host, strbench.sh prefixes its symbols with
+ *	loli_ to keep them apart from the C library.
+ */
+
+#include "../src/string.c"
+
+/* itoa_n() is internal to vsprintf(), export it for the benchmark */
+int
+loli_itoa_n(char *out, unsigned long int n, int base)
+{
+	return itoa_n(out, n, base);
+}
@@ -0,0 +1,515 @@
+/*
+ *	loli-loader testsuite
+ *	/tests/strbench.c
+ *	Benchmark of src/string.c against the C library
+ *
+ *	memcpy(), memmove(), memset() and memcmp() are checked against the C
+ *	library first, with random sizes, alignments and overlaps. Run with
+ *	"check" as the argument to skip the benchmark.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <wchar.h>
+
+/* src/string.c, renamed by strbench.sh. wchar_t is 16-bit in loli-loader */
+size_t loli_strlen(const char *p);
+size_t loli_wcs2str(char *str, const uint16_t *wcs);
+size_t loli_str2wcs(uint16_t *wcs, const char *str);
+void loli_vsprintf(char *p, const char *format, va_list va);
+void *loli_memcpy(void *dst, const void *src, size_t n);
+void *loli_memmove(void *dst, const void *src, size_t n);
+void *loli_memset(void *mem, int c, size_t n);
+int loli_memcmp(const void *a, const void *b, size_t len);
+int loli_atou(const char *p);
+int loli_itoa_n(char *out, unsigned long int n, int base);
+
+#define BENCH_MAX_SIZE		(1 << 20)
+#define BENCH_BUF_SIZE		(BENCH_MAX_SIZE + 256)
+/* Bytes processed per measurement, and measurements to take the best of */
+#define BENCH_BYTES		(8 << 20)
+#define BENCH_ROUNDS		3
+
+enum {
+	IMPL_LOLI,
+	IMPL_LIBC,
+	IMPL_NUM,
+};
+
+typedef struct {
+	size_t dst, src;
+} Bench_Align;
+
+typedef struct {
+	const char *name;
+	void (*run)(int impl, size_t n, const Bench_Align *align);
+	const size_t *sizes;
+	/* NULL if the function doesn't care about alignment */
+	const Bench_Align *aligns;
+} Bench;
+
+static const size_t memorySizes[] = { 8, 64, 512, 4096, 65536, BENCH_MAX_SIZE,
+				      0 };
+static const Bench_Align memoryAligns[] = {
+	{ 0, 0 },	// both aligned
+	{ 3, 3 },	// misaligned by the same offset
+	{ 1, 0 },	// misaligned to each other
+};
+#define BENCH_ALIGN_NUM	(sizeof(memoryAligns) / sizeof(memoryAligns[0]))
+
+/* Lengths in digits */
+static const size_t atouSizes[] = { 1, 4, 9, 0 };
+static const size_t itoaSizes[] = { 1, 10, 19, 0 };
+
+/* Correctness checks, sizes are mostly small with a large one in a while */
+#define CHECK_ROUNDS		5000
+#define CHECK_SMALL_SIZE	512
+#define CHECK_LARGE_SIZE	65536
+#define CHECK_ALIGN		64
+#define CHECK_SEED		20250101
+
+static uint8_t *bufA, *bufB, *bufRef;
+static uint16_t *wbuf;
+static wchar_t *libcWbuf;
+static volatile int sink;
+
+/*
+ * The C library functions are called through volatile pointers, or the
+ * compiler would inline them or drop calls with unused results.
+ */
+static void *(*volatile memcpyImpl[IMPL_NUM])(void *, const void *, size_t) = {
+	loli_memcpy, memcpy,
+};
+static void *(*volatile memmoveImpl[IMPL_NUM])(void *, const void *, size_t) = {
+	loli_memmove, memmove,
+};
+static void *(*volatile memsetImpl[IMPL_NUM])(void *, int, size_t) = {
+	loli_memset, memset,
+};
+static int (*volatile memcmpImpl[IMPL_NUM])(const void *, const void *,
+					    size_t) = {
+	loli_memcmp, memcmp,
+};
+static size_t (*volatile strlenImpl[IMPL_NUM])(const char *) = {
+	loli_strlen, strlen,
+};
+static size_t (*volatile mbstowcsPtr)(wchar_t *, const char *, size_t) =
+	mbstowcs;
+static size_t (*volatile wcstombsPtr)(char *, const wchar_t *, size_t) =
+	wcstombs;
+static unsigned long int (*volatile strtoulPtr)(const char *, char **, int) =
+	strtoul;
+static int (*volatile snprintfPtr)(char *, size_t, const char *, ...) =
+	snprintf;
+
+static void
+run_memcpy(int impl, size_t n, const Bench_Align *a)
+{
+	memcpyImpl[impl](bufB + a->dst, bufA + a->src, n);
+}
+
+/* Overlapping with dst above src, thus copying backwards */
+static void
+run_memmove(int impl, size_t n, const Bench_Align *a)
+{
+	memmoveImpl[impl](bufA + 128 + a->dst, bufA + a->src, n);
+}
+
+static void
+run_memset(int impl, size_t n, const Bench_Align *a)
+{
+	memsetImpl[impl](bufA + a->dst, 0x5a, n);
+}
+
+/* Equal buffers, the whole length is compared */
+static void
+run_memcmp(int impl, size_t n, const Bench_Align *a)
+{
+	sink = memcmpImpl[impl](bufA + a->dst, bufB + a->src, n);
+}
+
+static void
+run_strlen(int impl, size_t n, const Bench_Align *a)
+{
+	char *s = (char *)bufA + a->dst;
+
+	s[n] = '\0';
+	sink = strlenImpl[impl](s);
+	s[n] = 'a';
+}
+
+static void
+run_str2wcs(int impl, size_t n, const Bench_Align *a)
+{
+	char *s = (char *)bufA + a->dst;
+
+	s[n] = '\0';
+	if (impl == IMPL_LOLI)
+		sink = loli_str2wcs(wbuf, s);
+	else
+		sink = mbstowcsPtr(libcWbuf, s, n + 1);
+	s[n] = 'a';
+}
+
+static void
+run_wcs2str(int impl, size_t n, const Bench_Align *a)
+{
+	(void)a;
+
+	if (impl == IMPL_LOLI) {
+		wbuf[n] = 0;
+		sink = loli_wcs2str((char *)bufB, wbuf);
+		wbuf[n] = 'a';
+	} else {
+		libcWbuf[n] = 0;
+		sink = wcstombsPtr((char *)bufB, libcWbuf, n + 1);
+		libcWbuf[n] = 'a';
+	}
+}
+
+static void
+loli_sprintf(char *p, const char *format, ...)
+{
+	va_list va;
+
+	va_start(va, format);
+	loli_vsprintf(p, format, va);
+	va_end(va);
+}
+
+static void (*volatile sprintfImpl)(char *, const char *, ...) = loli_sprintf;
+
+/* A string argument of n bytes, followed by an integer of each kind */
+static void
+run_vsprintf(int impl, size_t n, const Bench_Align *a)
+{
+	char *s = (char *)bufA + a->src;
+
+	s[n] = '\0';
+	if (impl == IMPL_LOLI)
+		sprintfImpl((char *)bufB + a->dst, "%s:%d:%x:%lu:%c", s,
+			    -12345, 0xbeef, 1234567890123ul, 'z');
+	else
+		sink = snprintfPtr((char *)bufB + a->dst, BENCH_BUF_SIZE,
+				   "%s:%d:%x:%lu:%c", s, -12345, 0xbeef,
+				   1234567890123ul, 'z');
+	s[n] = 'a';
+}
+
+static const char *atouInputs[] = {
+	[1] = "7", [4] = "1234", [9] = "123456789",
+};
+
+static void
+run_atou(int impl, size_t n, const Bench_Align *a)
+{
+	(void)a;
+
+	if (impl == IMPL_LOLI)
+		sink = loli_atou(atouInputs[n]);
+	else
+		sink = strtoulPtr(atouInputs[n], NULL, 10);
+}
+
+static const unsigned long int itoaInputs[] = {
+	[1] = 7, [10] = 1234567890ul, [19] = 1234567890123456789ul,
+};
+
+static void
+run_itoa_n(int impl, size_t n, const Bench_Align *a)
+{
+	(void)a;
+
+	if (impl == IMPL_LOLI)
+		sink = loli_itoa_n((char *)bufB, itoaInputs[n], 10);
+	else
+		sink = snprintfPtr((char *)bufB, 32, "%lu", itoaInputs[n]);
+}
+
+static const Bench benches[] = {
+	{ "memcpy",	run_memcpy,	memorySizes,	memoryAligns },
+	{ "memmove",	run_memmove,	memorySizes,	memoryAligns },
+	{ "memset",	run_memset,	memorySizes,	memoryAligns },
+	{ "memcmp",	run_memcmp,	memorySizes,	memoryAligns },
+	{ "strlen",	run_strlen,	memorySizes,	memoryAligns },
+	{ "str2wcs",	run_str2wcs,	memorySizes,	memoryAligns },
+	{ "wcs2str",	run_wcs2str,	memorySizes,	NULL },
+	{ "vsprintf",	run_vsprintf,	memorySizes,	memoryAligns },
+	{ "atou",	run_atou,	atouSizes,	NULL },
+	{ "itoa_n",	run_itoa_n,	itoaSizes,	NULL },
+};
+
+static void
+fill_random(uint8_t *p, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		p[i] = rand();
+}
+
+/* A random number in [0, n) */
+static size_t
+random_below(size_t n)
+{
+	return (size_t)rand() % n;
+}
+
+static size_t
+random_size(void)
+{
+	if (!random_below(16))
+		return random_below(CHECK_LARGE_SIZE + 1);
+
+	return random_below(CHECK_SMALL_SIZE + 1);
+}
+
+static int
+sign(int x)
+{
+	return (x > 0) - (x < 0);
+}
+
+/*
+ * Report the first mismatch in window bytes of got and expect, return whether
+ * there's one.
+ */
+static int
+check_bytes(const char *name, size_t n, size_t dst, size_t src,
+	    const uint8_t *got, const uint8_t *expect, size_t window)
+{
+	for (size_t i = 0; i < window; i++) {
+		if (got[i] == expect[i])
+			continue;
+
+		fprintf(stderr, "%s: size %zu, dst %zu, src %zu: "
+			"byte %zu is 0x%02x, expect 0x%02x\n",
+			name, n, dst, src, i, got[i], expect[i]);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int
+check_memcpy(void)
+{
+	size_t n = random_size();
+	size_t dst = random_below(CHECK_ALIGN), src = random_below(CHECK_ALIGN);
+	size_t window = n + 2 * CHECK_ALIGN;
+
+	fill_random(bufA, window);
+	fill_random(bufB, window);
+	memcpy(bufRef, bufB, window);
+
+	memcpy(bufRef + dst, bufA + src, n);
+	if (loli_memcpy(bufB + dst, bufA + src, n) != bufB + dst) {
+		fprintf(stderr, "memcpy: wrong return value\n");
+		return 1;
+	}
+
+	return check_bytes("memcpy", n, dst, src, bufB, bufRef, window);
+}
+
+/* dst and src overlap in either direction, or not at all if n is small */
+static int
+check_memmove(void)
+{
+	size_t n = random_size();
+	size_t span = n / 2 + CHECK_ALIGN;
+	size_t dst = random_below(span), src = random_below(span);
+	size_t window = n + span;
+
+	fill_random(bufA, window);
+	memcpy(bufRef, bufA, window);
+
+	memmove(bufRef + dst, bufRef + src, n);
+	if (loli_memmove(bufA + dst, bufA + src, n) != bufA + dst) {
+		fprintf(stderr, "memmove: wrong return value\n");
+		return 1;
+	}
+
+	return check_bytes("memmove", n, dst, src, bufA, bufRef, window);
+}
+
+static int
+check_memset(void)
+{
+	size_t n = random_size();
+	size_t dst = random_below(CHECK_ALIGN);
+	size_t window = n + 2 * CHECK_ALIGN;
+	/* Only the low byte of c counts */
+	int c = (int)random_below(1024) - 512;
+
+	fill_random(bufA, window);
+	memcpy(bufRef, bufA, window);
+
+	memset(bufRef + dst, c, n);
+	if (loli_memset(bufA + dst, c, n) != bufA + dst) {
+		fprintf(stderr, "memset: wrong return value\n");
+		return 1;
+	}
+
+	return check_bytes("memset", n, dst, 0, bufA, bufRef, window);
+}
+
+/* Equal buffers, or ones differing in a single byte */
+static int
+check_memcmp(void)
+{
+	size_t n = random_size();
+	size_t a = random_below(CHECK_ALIGN), b = random_below(CHECK_ALIGN);
+
+	fill_random(bufA + a, n);
+	memcpy(bufB + b, bufA + a, n);
+
+	if (n && random_below(4)) {
+		size_t i = random_below(n);
+		bufB[b + i] ^= 1 + random_below(255);
+	}
+
+	int got = sign(loli_memcmp(bufA + a, bufB + b, n));
+	int expect = sign(memcmp(bufA + a, bufB + b, n));
+	if (got != expect) {
+		fprintf(stderr, "memcmp: size %zu, a %zu, b %zu: "
+			"got %d, expect %d\n", n, a, b, got, expect);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int (*const checks[])(void) = {
+	check_memcpy, check_memmove, check_memset, check_memcmp,
+};
+
+static const char *checkNames[] = {
+	"memcpy", "memmove", "memset", "memcmp",
+};
+
+/* Return the number of functions failing the check */
+static int
+check(void)
+{
+	int failed = 0;
+
+	srand(CHECK_SEED);
+
+	for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+		int ok = 1;
+
+		for (int round = 0; round < CHECK_ROUNDS && ok; round++)
+			ok = !checks[i]();
+
+		printf("check %-10s %s\n", checkNames[i], ok ? "OK" : "FAILED");
+		failed += !ok;
+	}
+
+	fflush(stdout);
+	return failed;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Nanoseconds per byte, the best of BENCH_ROUNDS */
+static double
+measure(const Bench *b, int impl, size_t n, const Bench_Align *align)
+{
+	size_t iterations = BENCH_BYTES / n;
+	double best = 0;
+
+	for (int round = 0; round < BENCH_ROUNDS; round++) {
+		double start = now();
+
+		for (size_t i = 0; i < iterations; i++)
+			b->run(impl, n, align);
+
+		double t = (now() - start) / ((double)iterations * n);
+		if (!round || t < best)
+			best = t;
+	}
+
+	return best;
+}
+
+static void
+report(const Bench *b, size_t n, const Bench_Align *align)
+{
+	char alignStr[16] = "-";
+	double t[IMPL_NUM];
+
+	if (align)
+		snprintf(alignStr, sizeof(alignStr), "%zu/%zu",
+			 align->dst, align->src);
+
+	for (int impl = 0; impl < IMPL_NUM; impl++)
+		t[impl] = measure(b, impl, n, align);
+
+	printf("%-10s %8zu %6s %10.4f %10.4f %8.2f\n", b->name, n, alignStr,
+	       t[IMPL_LOLI], t[IMPL_LIBC], t[IMPL_LOLI] / t[IMPL_LIBC]);
+	fflush(stdout);
+}
+
+/* Benchmarks may leave anything in the buffers, fill them again */
+static void
+fill_buffers(void)
+{
+	memset(bufA, 'a', BENCH_BUF_SIZE);
+	memset(bufB, 'a', BENCH_BUF_SIZE);
+	for (size_t i = 0; i < BENCH_BUF_SIZE; i++) {
+		wbuf[i]		= 'a';
+		libcWbuf[i]	= 'a';
+	}
+}
+
+int
+main(int argc, const char *argv[])
+{
+	bufA = malloc(BENCH_BUF_SIZE);
+	bufB = malloc(BENCH_BUF_SIZE);
+	bufRef = malloc(BENCH_BUF_SIZE);
+	wbuf = malloc(BENCH_BUF_SIZE * sizeof(*wbuf));
+	libcWbuf = malloc(BENCH_BUF_SIZE * sizeof(*libcWbuf));
+	if (!bufA || !bufB || !bufRef || !wbuf || !libcWbuf) {
+		fputs("can't allocate buffers\n", stderr);
+		return 1;
+	}
+
+	if (check())
+		return 1;
+
+	if (argc > 1 && !strcmp(argv[1], "check"))
+		return 0;
+
+	printf("%-10s %8s %6s %10s %10s %8s\n", "function", "size", "align",
+	       "loli ns/B", "libc ns/B", "ratio");
+
+	for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+		const Bench *b = &benches[i];
+
+		for (const size_t *n = b->sizes; *n; n++) {
+			fill_buffers();
+
+			if (!b->aligns) {
+				report(b, *n, NULL);
+				continue;
+			}
+
+			for (size_t j = 0; j < BENCH_ALIGN_NUM; j++)
+				report(b, *n, &b->aligns[j]);
+		}
+	}
+
+	return 0;
+}
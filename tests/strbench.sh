@@ -0,0 +1,56 @@
+set -e
+
+# The functions src/string.c exports, renamed to loli_* for the host build
+SYMS="strlen strcpy strcmp strncmp wcslen wcscpy wcscmp wcs2str str2wcs
+      vsprintf memcpy memmove memset atou strscpy memcmp"
+
+RENAME=
+for s in $SYMS; do
+	RENAME="$RENAME -D$s=loli_$s"
+done
+
+# CC, ARCH and RUN could be set to build for another architecture, and run
+# it under an emulator like qemu-aarch64. Arguments are passed to strbench.
+CC=${CC:-cc}
+ARCH=${ARCH:-$(uname -m)}
+
+case $ARCH in
+x86_64)		TARGET=-DLOLI_TARGET_X86_64 ;;
+aarch64)	TARGET=-DLOLI_TARGET_AARCH64 ;;
+riscv64)	TARGET=-DLOLI_TARGET_RISCV64 ;;
+loongarch64)	TARGET=-DLOLI_TARGET_LOONGARCH64 ;;
+*)		echo "unsupported host $ARCH"; exit 1 ;;
+esac
+
+# Check and measure the assembly routines as well, if the loader would use
+# them. See ARCH_STRING in the Makefile.
+OBJS=strbench-loli.o
+if [ -z "$PORTABLE_STRING" ]; then
+	case $TARGET in
+	*X86_64)
+		ARCH_STRING=yes
+		;;
+	*AARCH64)
+		ARCH_STRING=$AARCH64_STRING
+		;;
+	esac
+fi
+
+if [ -n "$ARCH_STRING" ]; then
+	TARGET="$TARGET -DLOLI_ARCH_STRING"
+	OBJS="$OBJS strbench-stringops.o"
+fi
+
+LOLIFLAGS="-ffreestanding -fno-stack-protector -fshort-wchar -nostdinc
+	   -std=c99 -O2 -I../include $TARGET $RENAME"
+
+$CC $LOLIFLAGS -c strbench-loli.c -o strbench-loli.o -Wall -Werror
+case $OBJS in
+*stringops*)
+	$CC $LOLIFLAGS -c ../src/stringops.S -o strbench-stringops.o
+	;;
+esac
+
+$CC strbench.c $OBJS -o strbench -O2 -Wall -Werror -pedantic -Wextra
+trap 'rm -f strbench $OBJS' EXIT
+$RUN ./strbench "$@"
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+#	SPDX-License-Identifier: MPL-2.0
+#	loli-loader
+#	/tools/extlinuxkeys.py
+#	Copyright (c) 2025 Yao Zi.
+#
+#	Generate include/extlinuxkeys.h, the keys recognized in configuration
+#	files, with a perfect hash table of their first tokens. Add new keys
+#	here and run "make keys".
+
+import sys
+
+# Enumerator suffix and key, tokens of a key are separated by a single space
+KEYS = [
+	("LABEL",	"label"),
+	("MENU_TITLE",	"menu title"),
+	("KERNEL",	"kernel"),
+	("FDT",		"fdt"),
+	("DEVICETREE",	"devicetree"),
+	("INITRD",	"initrd"),
+	("APPEND",	"append"),
+	("BENCHFILE",	"benchfile"),
+	("DEFAULT",	"default"),
+	("TIMEOUT",	"timeout"),
+	("MEMMAP",	"memmap"),
+	("INCLUDE",	"include"),
+	# Boot Loader Specification entries
+	("TITLE",	"title"),
+	("VERSION",	"version"),
+	("LINUX",	"linux"),
+	("OPTIONS",	"options"),
+	("SORT_KEY",	"sort-key"),
+]
+
+# Must match EXTLINUX_KEY_HASH() emitted below
+def key_hash(token, a, b, size):
+	return (ord(token[0]) * a + ord(token[-1]) * b + len(token)) % size
+
+def find_hash(tokens):
+	size = 1
+	while size < len(tokens):
+		size *= 2
+
+	while True:
+		for a in range(1, 64):
+			for b in range(1, 64):
+				hashes = {key_hash(t, a, b, size) for t in tokens}
+				if len(hashes) == len(tokens):
+					return a, b, size
+		size *= 2
+
+# Pad s, which starts with a tab, with tabs to the column after width
+def pad(s, width):
+	return s + "\t" * ((8 + width) // 8 + 1 - (7 + len(s)) // 8)
+
+def main():
+	# Keys sharing a first token are kept consecutive
+	firsts = []
+	for _, key in KEYS:
+		first = key.split(" ")[0]
+		if first not in firsts:
+			firsts.append(first)
+
+	keys = sorted(KEYS, key = lambda k: firsts.index(k[1].split(" ")[0]))
+	a, b, size = find_hash(firsts)
+
+	slots = [None] * size
+	for first in firsts:
+		indices = [i for i, k in enumerate(keys)
+			   if k[1].split(" ")[0] == first]
+		slots[key_hash(first, a, b, size)] = (indices[0], len(indices))
+
+	out = sys.stdout
+	out.write("""// SPDX-License-Identifier: MPL-2.0
+/*
+ *	loli-loader
+ *	/include/extlinuxkeys.h
+ *	Generated by tools/extlinuxkeys.py, DO NOT EDIT.
+ */
+
+#ifndef __LOLI_EXTLINUXKEYS_H_INC__
+#define __LOLI_EXTLINUXKEYS_H_INC__
+
+typedef enum {
+""")
+	for name, _ in keys:
+		out.write(f"\tEXTLINUX_KEY_{name},\n")
+	out.write("""\tEXTLINUX_KEY_NUM,
+} Extlinux_Key;
+
+#ifdef EXTLINUX_KEYS_TABLE
+
+""")
+	out.write(f"#define EXTLINUX_KEY_HASH_SIZE\t{size}\n")
+	out.write("#define EXTLINUX_KEY_HASH(first, last, len) \\\n")
+	out.write(f"\t(((first) * {a} + (last) * {b} + (len)) % "
+		  "EXTLINUX_KEY_HASH_SIZE)\n\n")
+
+	out.write("static const char *keyNames[EXTLINUX_KEY_NUM] = {\n")
+	width = max(len(f"[EXTLINUX_KEY_{name}]") for name, _ in keys)
+	for name, key in keys:
+		out.write(pad(f"\t[EXTLINUX_KEY_{name}]", width) +
+			  f"= \"{key}\",\n")
+	out.write("};\n\n")
+
+	out.write("""/*
+ * Keys by hash of their first token, num is zero for empty slots. Keys sharing
+ * a first token start from key and are consecutive.
+ */
+static const struct {
+	unsigned char key;
+	unsigned char num;
+} keyHash[EXTLINUX_KEY_HASH_SIZE] = {
+""")
+	for h, slot in enumerate(slots):
+		if slot:
+			out.write(f"\t[{h}]\t= {{ EXTLINUX_KEY_"
+				  f"{keys[slot[0]][0]}, {slot[1]} }},\n")
+	out.write("""};
+
+#endif	// EXTLINUX_KEYS_TABLE
+
+#endif	// __LOLI_EXTLINUXKEYS_H_INC__
+""")
+
+main()